@@ -15,6 +15,8 @@
 #include "qmozenginesettings.h"
 #include "qmozscrolldecorator.h"
 #include "qmozsecurity.h"
+#include "qmozthumbnailcache.h"
+#include "qmozviewdiagnostics.h"
 
 template <typename T> static QObject *singletonApiFactory(QQmlEngine *engine, QJSEngine *)
 {
@@ -35,12 +37,21 @@ public:
                                               singletonApiFactory<QMozContext>);
         qmlRegisterSingletonType<QMozEngineSettings>("Qt5Mozilla", 1, 0, "QMozEngineSettings",
                                               singletonApiFactory<QMozEngineSettings>);
+        qmlRegisterSingletonType<QMozThumbnailCache>("Qt5Mozilla", 1, 0, "QMozThumbnailCache",
+                                              singletonApiFactory<QMozThumbnailCache>);
 
         qmlRegisterUncreatableType<QMozScrollDecorator>("Qt5Mozilla", 1, 0, "QmlMozScrollDecorator", "");
         qmlRegisterUncreatableType<QMozReturnValue>("Qt5Mozilla", 1, 0, "QMozReturnValue", "");
         qmlRegisterType<QMozSecurity>("Qt5Mozilla", 1, 0, "QMozSecurity");
+        qmlRegisterUncreatableType<QMozViewDiagnostics>("Qt5Mozilla", 1, 0, "QMozViewDiagnostics", "");
         setenv("EMBED_COMPONENTS_PATH", DEFAULT_COMPONENTS_PATH, 1);
     }
+
+    void initializeEngine(QQmlEngine *engine, const char *uri)
+    {
+        Q_UNUSED(uri);
+        engine->addImageProvider(QMozThumbnailProvider::providerId(), new QMozThumbnailProvider);
+    }
 };
 
 #include "main.moc"
@@ -6,10 +6,11 @@
 
 #include <Qt>
 
+#include <iterator>
+
 #include "EmbedQtKeyUtils.h"
 
 #include "nsIDOMWindowUtils.h"
-#include "mozilla/ArrayUtils.h"      // for ArrayLength
 
 
 struct nsKeyConverter {
@@ -216,7 +217,7 @@ namespace KeyboardEventBinding {
 
 using namespace mozilla;
 
-static struct nsKeyConverter nsKeycodes[] = {
+static constexpr nsKeyConverter nsKeycodes[] = {
 //  { dom::KeyboardEventBinding::DOM_VK_CANCEL,        Qt::Key_Cancel },
     { dom::KeyboardEventBinding::DOM_VK_BACK_SPACE,    Qt::Key_Backspace },
     { dom::KeyboardEventBinding::DOM_VK_TAB,           Qt::Key_Tab },
@@ -340,11 +341,47 @@ static struct nsKeyConverter nsKeycodes[] = {
     { dom::KeyboardEventBinding::DOM_VK_META,          Qt::Key_Meta }
 };
 
+// Qt key codes are either Latin-1 or in the 0x01000000 - 0x010000ff range of
+// special keys, DOM key codes fit into a byte. That makes direct indexing
+// possible in both directions.
+static constexpr int kSpecialKeyBase = 0x01000000;
+
+struct nsKeyTables {
+    uint8_t latin1ToDOM[256];
+    uint8_t specialToDOM[256];
+    int domToQt[256];
+};
+
+static constexpr nsKeyTables BuildKeyTables()
+{
+    nsKeyTables tables {};
+    // Walk backwards so that the first entry of nsKeycodes wins, as it did
+    // with the linear lookups.
+    for (size_t i = std::size(nsKeycodes); i-- > 0;) {
+        const nsKeyConverter &key = nsKeycodes[i];
+        if (key.keysym >= 0 && key.keysym < 0x100) {
+            tables.latin1ToDOM[key.keysym] = static_cast<uint8_t>(key.vkCode);
+        } else if (key.keysym >= kSpecialKeyBase && key.keysym < kSpecialKeyBase + 0x100) {
+            tables.specialToDOM[key.keysym - kSpecialKeyBase] = static_cast<uint8_t>(key.vkCode);
+        }
+        tables.domToQt[key.vkCode & 0xFF] = key.keysym;
+    }
+    return tables;
+}
+
+static constexpr nsKeyTables sKeyTables = BuildKeyTables();
+
+static_assert(sKeyTables.specialToDOM[Qt::Key_Return - kSpecialKeyBase] == dom::KeyboardEventBinding::DOM_VK_RETURN,
+              "Qt to DOM key table is broken");
+static_assert(sKeyTables.domToQt[dom::KeyboardEventBinding::DOM_VK_TAB] == Qt::Key_Tab,
+              "DOM to Qt key table is broken");
+
+// Key down state of every DOM key code.
+static uint32_t sKeyDownFlags[8];
+
 int
 MozKey::QtKeyCodeToDOMKeyCode(int aKeysym, int aModifier)
 {
-    unsigned int i;
-
     // First, try to handle alphanumeric input, not listed in nsKeycodes:
     // most likely, more letters will be getting typed in than things in
     // the key list, so we will look through these first.
@@ -363,10 +400,11 @@ MozKey::QtKeyCodeToDOMKeyCode(int aKeysym, int aModifier)
         return aKeysym - Qt::Key_0 + dom::KeyboardEventBinding::DOM_VK_NUMPAD0;
 
     // misc other things
-    for (i = 0; i < ArrayLength(nsKeycodes); i++) {
-        if (nsKeycodes[i].keysym == aKeysym)
-            return (nsKeycodes[i].vkCode);
-    }
+    if (aKeysym >= 0 && aKeysym < 0x100 && sKeyTables.latin1ToDOM[aKeysym])
+        return sKeyTables.latin1ToDOM[aKeysym];
+    if (aKeysym >= kSpecialKeyBase && aKeysym < kSpecialKeyBase + 0x100
+            && sKeyTables.specialToDOM[aKeysym - kSpecialKeyBase])
+        return sKeyTables.specialToDOM[aKeysym - kSpecialKeyBase];
 
     // function keys
     if (aKeysym >= Qt::Key_F1 && aKeysym <= Qt::Key_F24)
@@ -378,8 +416,6 @@ MozKey::QtKeyCodeToDOMKeyCode(int aKeysym, int aModifier)
 int
 MozKey::DOMKeyCodeToQtKeyCode(uint32_t aKeysym)
 {
-    unsigned int i;
-
     // First, try to handle alphanumeric input, not listed in nsKeycodes:
     // most likely, more letters will be getting typed in than things in
     // the key list, so we will look through these first.
@@ -403,10 +439,8 @@ MozKey::DOMKeyCodeToQtKeyCode(uint32_t aKeysym)
     }
 
     // misc other things
-    for (i = 0; i < ArrayLength(nsKeycodes); ++i) {
-        if (nsKeycodes[i].vkCode == aKeysym) {
-            return nsKeycodes[i].keysym;
-        }
+    if (aKeysym < 0x100 && sKeyTables.domToQt[aKeysym]) {
+        return sKeyTables.domToQt[aKeysym];
     }
 
     // function keys
@@ -421,13 +455,11 @@ MozKey::GetFlagWord32(uint32_t aKeyCode, uint32_t *aMask)
 {
     /* Mozilla DOM Virtual Key Code is from 0 to 224. */
     // NS_ASSERTION((aKeyCode <= 0xFF), "Invalid DOM Key Code");
-    static uint32_t mKeyDownFlags[8];
-    memset(mKeyDownFlags, 0, sizeof(mKeyDownFlags));
     aKeyCode &= 0xFF;
 
     /* 32 = 2^5 = 0x20 */
     *aMask = uint32_t(1) << (aKeyCode & 0x1F);
-    return &mKeyDownFlags[(aKeyCode >> 5)];
+    return &sKeyDownFlags[(aKeyCode >> 5)];
 }
 
 bool
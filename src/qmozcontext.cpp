@@ -12,12 +12,21 @@
 #include <QVariant>
 #include <QThread>
 #include <QGuiApplication>
+#include <QJsonArray>
 #include <QJsonDocument>
+#include <QJsonObject>
 #include <QJsonParseError>
+#include <QMetaMethod>
+#include <QMutex>
+#include <QTimer>
+#include <QVector>
 #include <QtQml/QtQml>
+#include <QtConcurrent/QtConcurrentRun>
 
+#include <algorithm>
 #include <dlfcn.h>
 #include <link.h>
+#include <string>
 
 #include "qmessagepump.h"
 #include "qmozembedlog.h"
@@ -25,8 +34,11 @@
 #include "qmozcontext_p.h"
 #include "qmozenginesettings.h"
 #include "qmozviewcreator.h"
+#include "qmozview_p.h"
+#include "qmozviewpool_p.h"
 #include "geckoworker.h"
 #include "qmozwindow.h"
+#include "qmozwindow_p.h"
 
 #include "nsDebug.h"
 #include "mozilla/embedlite/EmbedLiteMessagePump.h"
@@ -37,6 +49,50 @@ Q_LOGGING_CATEGORY(lcEmbedLiteExt, "org.sailfishos.embedliteext", QtWarningMsg)
 
 using namespace mozilla::embedlite;
 
+// Number of most recently shown background views that keep running timeouts.
+#ifndef MOZCONTEXT_RECENT_BACKGROUND_VIEWS
+#define MOZCONTEXT_RECENT_BACKGROUND_VIEWS 3
+#endif
+
+// Time a background view may keep running timeouts after it was last shown.
+#ifndef MOZCONTEXT_BACKGROUND_BUDGET
+#define MOZCONTEXT_BACKGROUND_BUDGET (60 * 1000)
+#endif
+
+// Time after which a background view is frozen.
+#ifndef MOZCONTEXT_FROZEN_TIMEOUT
+#define MOZCONTEXT_FROZEN_TIMEOUT (10 * 60 * 1000)
+#endif
+
+// Interval at which background views are aged into lower tiers.
+#ifndef MOZCONTEXT_VIEW_TIER_INTERVAL
+#define MOZCONTEXT_VIEW_TIER_INTERVAL (10 * 1000)
+#endif
+
+// Minimum time between heap minimizations triggered by frozen views.
+#ifndef MOZCONTEXT_MEMORY_TRIM_INTERVAL
+#define MOZCONTEXT_MEMORY_TRIM_INTERVAL (60 * 1000)
+#endif
+
+// Maximum number of recorded startup timeline marks.
+#ifndef MOZCONTEXT_STARTUP_MARKS
+#define MOZCONTEXT_STARTUP_MARKS 512
+#endif
+
+namespace {
+struct StartupMark {
+    QByteArray name;
+    qint64 timestamp;
+    quint32 viewId;
+};
+
+struct StartupTimeline {
+    QMutex mutex;
+    QVector<StartupMark> marks;
+};
+}
+
+Q_GLOBAL_STATIC(StartupTimeline, startupTimelineInstance)
 Q_GLOBAL_STATIC(QMozContext, mozContextInstance)
 Q_GLOBAL_STATIC(QMozContextPrivate, mozContextPrivateInstance)
 
@@ -87,11 +143,63 @@ static void platform_egl_workaround_close() {
   }
 }
 
+static void prepare_environment()
+{
+    static bool sPrepared = false;
+    if (sPrepared) {
+        return;
+    }
+    sPrepared = true;
+
+    setenv("BUILD_GRE_HOME", BUILD_GRE_HOME, 1);
+    // See JB#11625: JSON message are locale aware avoid breaking them
+    // This is moved from the sailfish-components-webview.
+    setenv("LC_NUMERIC", "C", 1);
+    setlocale(LC_NUMERIC, "C");
+
+    // GRE_HOME must be set before QMozContext is initialized. With invoker PWD is empty.
+    QByteArray binaryPath = QCoreApplication::applicationDirPath().toLocal8Bit();
+    setenv("GRE_HOME", binaryPath.constData(), 1);
+}
+
+// Loads libxul, this is safe to do on any thread.
+static bool load_engine()
+{
+    QMozContextPrivate::markStartup("EngineLoadStart");
+    platform_egl_workaround_open();
+
+    Q_ASSERT_X(LoadEmbedLite(), __PRETTY_FUNCTION__, "Failed load XPCOMGlue");
+    QMozContextPrivate::markStartup("EngineLoaded");
+    return true;
+}
+
+static QFuture<bool> &engine_bootstrap()
+{
+    static QFuture<bool> sBootstrap;
+    return sBootstrap;
+}
+
 QMozContextPrivate *QMozContextPrivate::instance()
 {
     return mozContextPrivateInstance();
 }
 
+// Records a startup timeline mark with the CLOCK_MONOTONIC time in microseconds,
+// the same clock QMozWindow uses for frame timing. Safe to call from any thread.
+void QMozContextPrivate::markStartup(const QByteArray &name, quint32 viewId)
+{
+    StartupTimeline *timeline = startupTimelineInstance();
+    if (!timeline) {
+        return;
+    }
+
+    // Read the clock under the lock so that marks stay in timestamp order.
+    QMutexLocker lock(&timeline->mutex);
+    if (timeline->marks.count() < MOZCONTEXT_STARTUP_MARKS) {
+        timeline->marks.append({ name, QMozWindowPrivate::monotonicMicroseconds(), viewId });
+    }
+}
+
 QMozContextPrivate::QMozContextPrivate(QObject *parent)
     : QObject(parent)
     , mApp(nullptr)
@@ -102,23 +210,44 @@ QMozContextPrivate::QMozContextPrivate(QObject *parent)
     , mAsyncContext(!getenv("DISABLE_ASYNC"))
     , mViewCreator(nullptr)
     , mMozWindow(nullptr)
+    , mViewThrottling(false)
+    , mViewTierUpdateScheduled(false)
+    , mLastMemoryTrim(-MOZCONTEXT_MEMORY_TRIM_INTERVAL)
+    , mLiveViewLimit(0)
+    , mViewPool(nullptr)
 {
     qCDebug(lcEmbedLiteExt) << "Create new Context:" << (void *)this
                             << ", parent:" << (void *)parent << getenv("GRE_HOME");
 
-    platform_egl_workaround_open();
+    markStartup("ContextCreated");
+    prepare_environment();
 
-    setenv("BUILD_GRE_HOME", BUILD_GRE_HOME, 1);
-    // See JB#11625: JSON message are locale aware avoid breaking them
-    // This is moved from the sailfish-components-webview.
-    setenv("LC_NUMERIC", "C", 1);
-    setlocale(LC_NUMERIC, "C");
+    mViewPool = new QMozViewPool(this);
 
-    // GRE_HOME must be set before QMozContext is initialized. With invoker PWD is empty.
-    QByteArray binaryPath = QCoreApplication::applicationDirPath().toLocal8Bit();
-    setenv("GRE_HOME", binaryPath.constData(), 1);
+    // Engine preloading started by QMozContext::preloadEngine() completes
+    // asynchronously, otherwise the engine is loaded right away.
+    const QFuture<bool> &bootstrap = engine_bootstrap();
+    if (bootstrap.isStarted() && !bootstrap.isFinished()) {
+        connect(&mBootstrapWatcher, &QFutureWatcher<bool>::finished,
+                this, &QMozContextPrivate::finishBootstrap);
+        mBootstrapWatcher.setFuture(bootstrap);
+    } else {
+        if (!bootstrap.isStarted()) {
+            load_engine();
+        }
+        finishBootstrap();
+    }
 
-    Q_ASSERT_X(LoadEmbedLite(), __PRETTY_FUNCTION__, "Failed load XPCOMGlue");
+    mViewClock.start();
+    mViewTierTimer.setInterval(MOZCONTEXT_VIEW_TIER_INTERVAL);
+    connect(&mViewTierTimer, &QTimer::timeout, this, &QMozContextPrivate::updateViewTiers);
+}
+
+void QMozContextPrivate::finishBootstrap()
+{
+    if (mApp) {
+        return;
+    }
 
     mApp = XRE_GetEmbedLite();
     mApp->SetListener(this);
@@ -126,6 +255,22 @@ QMozContextPrivate::QMozContextPrivate(QObject *parent)
     if (mAsyncContext) {
         mQtPump = new MessagePumpQt(mApp);
     }
+
+    Q_EMIT engineLoaded();
+}
+
+// Blocks until a pending engine preload has completed. The engine is set up
+// on the thread of the context, other threads cannot wait for it.
+void QMozContextPrivate::waitForBootstrap()
+{
+    if (!mApp) {
+        if (QThread::currentThread() != thread()) {
+            qCWarning(lcEmbedLiteExt) << "Engine is still loading, it can only be waited for on the main thread";
+            return;
+        }
+        mBootstrapWatcher.waitForFinished();
+        finishBootstrap();
+    }
 }
 
 QMozContextPrivate::~QMozContextPrivate()
@@ -155,6 +300,7 @@ bool QMozContextPrivate::StopChildThread()
 // App Initialized and ready to API call
 void QMozContextPrivate::Initialized()
 {
+    markStartup("Initialized");
     mInitialized = true;
 #if defined(GL_PROVIDER_EGL) || defined(GL_PROVIDER_GLX)
     if (mApp->GetRenderType() == EmbedLiteApp::RENDER_AUTO) {
@@ -174,6 +320,7 @@ void QMozContextPrivate::Initialized()
         mApp->AddObservers(observersList);
     }
 
+    mViewPool->scheduleRefill();
     Q_EMIT initialized();
 }
 
@@ -200,26 +347,134 @@ void QMozContextPrivate::Destroyed()
 
 void QMozContextPrivate::OnObserve(const char *aTopic, const char16_t *aData)
 {
-    //qCDebug(lcEmbedLiteExt) << "aTopic:" << aTopic << ", data:" << NS_ConvertUTF16toUTF8(aData).get();
-    QString data((QChar *)aData);
-    if (!data.startsWith('{') && !data.startsWith('[') && !data.startsWith('"')) {
-        QVariant vdata = QVariant::fromValue(data);
-        Q_EMIT recvObserve(aTopic, vdata);
+    const QByteArray topicKey = QByteArray::fromRawData(aTopic, qstrlen(aTopic));
+    // Copied so that callbacks may unsubscribe while being delivered to.
+    const QVector<ObserverSubscription> subscriptions = mSubscriptions.value(topicKey);
+
+    // Nobody listens, don't bother parsing the payload.
+    const bool broadcast = hasObserveReceivers();
+    if (subscriptions.isEmpty() && !broadcast) {
         return;
     }
-    bool ok = true;
-    QJsonParseError error;
-    QJsonDocument doc = QJsonDocument::fromJson(data.toUtf8(), &error);
-    ok = error.error == QJsonParseError::NoError;
-    QVariant vdata = doc.toVariant();
-    if (ok) {
-        //qCDebug(lcEmbedLiteExt) << "mesg:" << aTopic << ", data:" << data.toUtf8().data();
-        Q_EMIT recvObserve(aTopic, vdata);
+
+    //qCDebug(lcEmbedLiteExt) << "aTopic:" << aTopic << ", data:" << NS_ConvertUTF16toUTF8(aData).get();
+    const QString topic = QString::fromLatin1(aTopic);
+    // aData is only read during this call, wrap it instead of copying.
+    const QString data = QString::fromRawData(reinterpret_cast<const QChar *>(aData),
+                                              aData ? std::char_traits<char16_t>::length(aData) : 0);
+    QVariant vdata;
+    if (!data.startsWith('{') && !data.startsWith('[') && !data.startsWith('"')) {
+        vdata = QVariant::fromValue(QString(data.constData(), data.size()));
     } else {
-        qCDebug(lcEmbedLiteExt) << "JSON parse error:" << error.errorString().toUtf8().data();
+        QJsonParseError error;
+        QJsonDocument doc = QJsonDocument::fromJson(data.toUtf8(), &error);
+        if (error.error != QJsonParseError::NoError) {
+            qCDebug(lcEmbedLiteExt) << "JSON parse error:" << error.errorString().toUtf8().data();
 #ifdef DEVELOPMENT_BUILD
-        qCDebug(lcEmbedLiteExt) << "parse: s:'" << data.toUtf8().data() << "', errLine:" << error.offset;
+            qCDebug(lcEmbedLiteExt) << "parse: s:'" << data.toUtf8().data() << "', errLine:" << error.offset;
 #endif
+            return;
+        }
+        vdata = doc.toVariant();
+        //qCDebug(lcEmbedLiteExt) << "mesg:" << aTopic << ", data:" << data.toUtf8().data();
+    }
+
+    for (const ObserverSubscription &subscription : subscriptions) {
+        // An earlier callback may have deleted this receiver.
+        if (!subscription.receiver) {
+            continue;
+        }
+        if (subscription.receiver->thread() == QThread::currentThread()) {
+            subscription.callback(topic, vdata);
+        } else {
+            // Runs in the receiver's thread, and not at all if it is destroyed first.
+            const QMozContext::ObserverCallback callback = subscription.callback;
+            QTimer::singleShot(0, subscription.receiver.data(), [callback, topic, vdata]() {
+                callback(topic, vdata);
+            });
+        }
+    }
+
+    if (broadcast) {
+        Q_EMIT recvObserve(topic, vdata);
+    }
+}
+
+/*
+ * Subscriptions deliver notifications of a single topic to a single
+ * receiver, unlike recvObserve() which goes to everyone connected to it.
+ * A subscription ends when its receiver is destroyed.
+ */
+void QMozContextPrivate::subscribe(const QString &topic, QObject *receiver,
+                                   const QMozContext::ObserverCallback &callback)
+{
+    Q_ASSERT(receiver);
+
+    const QByteArray topicKey = topic.toLatin1();
+    QVector<ObserverSubscription> &subscriptions = mSubscriptions[topicKey];
+    for (ObserverSubscription &subscription : subscriptions) {
+        if (subscription.receiver == receiver) {
+            subscription.callback = callback;
+            return;
+        }
+    }
+
+    subscriptions.append(ObserverSubscription { receiver, callback });
+    connect(receiver, &QObject::destroyed, this, &QMozContextPrivate::subscriberDestroyed, Qt::UniqueConnection);
+    QMozContext::instance()->addObserver(topic);
+}
+
+void QMozContextPrivate::unsubscribe(const QString &topic, QObject *receiver)
+{
+    const QByteArray topicKey = topic.toLatin1();
+    auto subscriptions = mSubscriptions.find(topicKey);
+    if (subscriptions == mSubscriptions.end()) {
+        return;
+    }
+
+    for (int i = 0; i < subscriptions->count(); ++i) {
+        if (subscriptions->at(i).receiver == receiver) {
+            subscriptions->remove(i);
+            if (subscriptions->isEmpty()) {
+                mSubscriptions.erase(subscriptions);
+            }
+            if (QMozContext *context = QMozContext::instance()) {
+                context->removeObserver(topic);
+            }
+            return;
+        }
+    }
+}
+
+bool QMozContextPrivate::hasObserveReceivers() const
+{
+    const QMetaMethod signal = QMetaMethod::fromSignal(&QMozContext::recvObserve);
+    for (const QMozContext *context : mContexts) {
+        if (context->isSignalConnected(signal)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Receivers are already null here, QPointer is cleared before destroyed() is emitted.
+void QMozContextPrivate::subscriberDestroyed()
+{
+    QMozContext *context = QMozContext::instance();
+    for (auto subscriptions = mSubscriptions.begin(); subscriptions != mSubscriptions.end();) {
+        for (int i = subscriptions->count() - 1; i >= 0; --i) {
+            if (!subscriptions->at(i).receiver) {
+                subscriptions->remove(i);
+                if (context) {
+                    context->removeObserver(QString::fromLatin1(subscriptions.key()));
+                }
+            }
+        }
+        if (subscriptions->isEmpty()) {
+            subscriptions = mSubscriptions.erase(subscriptions);
+        } else {
+            ++subscriptions;
+        }
     }
 }
 
@@ -227,6 +482,9 @@ void QMozContextPrivate::destroyWindow()
 {
     if (!mMozWindow) return;
 
+    // Pooled views belong to the window.
+    mViewPool->clear();
+
     if (mMozWindow->isReserved()) {
         connect(mMozWindow.data(), &QMozWindow::released,
                 mMozWindow.data(), &QObject::deleteLater);
@@ -252,6 +510,142 @@ bool QMozContextPrivate::IsInitialized()
     return mApp && mInitialized;
 }
 
+void QMozContextPrivate::registerView(QMozViewPrivate *view)
+{
+    view->mLastShownTime = mViewClock.elapsed();
+    mViews.append(view);
+    scheduleViewTierUpdate();
+}
+
+void QMozContextPrivate::unregisterView(QMozViewPrivate *view)
+{
+    mViews.removeOne(view);
+    scheduleViewTierUpdate();
+}
+
+void QMozContextPrivate::scheduleViewTierUpdate()
+{
+    if (!mViewTierUpdateScheduled) {
+        mViewTierUpdateScheduled = true;
+        QMetaObject::invokeMethod(this, "updateViewTiers", Qt::QueuedConnection);
+    }
+}
+
+bool QMozContextPrivate::viewThrottling() const
+{
+    return mViewThrottling;
+}
+
+QMozViewPool *QMozContextPrivate::viewPool() const
+{
+    return mViewPool;
+}
+
+/*
+ * Active views are foreground, unless another active view has focus in
+ * which case they are merely visible. Hidden views are ordered by the time
+ * they were last shown: the most recent ones stay in the background-recent
+ * tier until their background budget is spent, the rest are background-old
+ * and eventually frozen.
+ */
+void QMozContextPrivate::updateViewTiers()
+{
+    mViewTierUpdateScheduled = false;
+
+    const qint64 now = mViewClock.elapsed();
+    bool hasFocusedView = false;
+    QList<QMozViewPrivate *> hiddenViews;
+    for (QMozViewPrivate *view : mViews) {
+        if (view->mActive) {
+            view->mLastShownTime = now;
+            hasFocusedView |= view->mViewIsFocused;
+        } else {
+            hiddenViews.append(view);
+        }
+    }
+
+    std::stable_sort(hiddenViews.begin(), hiddenViews.end(),
+                     [](const QMozViewPrivate *a, const QMozViewPrivate *b) {
+        return a->mLastShownTime > b->mLastShownTime;
+    });
+
+    bool frozenViewAdded = false;
+    for (QMozViewPrivate *view : mViews) {
+        QMozContext::ViewTier tier;
+        if (view->mActive) {
+            tier = !hasFocusedView || view->mViewIsFocused
+                    ? QMozContext::ForegroundTier : QMozContext::VisibleTier;
+        } else {
+            const qint64 hiddenTime = now - view->mLastShownTime;
+            if (hiddenTime >= MOZCONTEXT_FROZEN_TIMEOUT) {
+                tier = QMozContext::FrozenTier;
+            } else if (hiddenTime < MOZCONTEXT_BACKGROUND_BUDGET
+                       && hiddenViews.indexOf(view) < MOZCONTEXT_RECENT_BACKGROUND_VIEWS) {
+                tier = QMozContext::BackgroundRecentTier;
+            } else {
+                tier = QMozContext::BackgroundOldTier;
+            }
+        }
+
+        if (view->mTier != tier) {
+            frozenViewAdded |= tier == QMozContext::FrozenTier;
+            view->setTier(tier);
+            if (view->mView) {
+                Q_EMIT viewTierChanged(view->mView->GetUniqueID(), tier);
+            }
+        }
+    }
+
+    if (frozenViewAdded && mViewThrottling) {
+        trimMemory();
+    }
+
+    if (mLiveViewLimit > 0) {
+        discardViews(hiddenViews);
+    }
+
+    if (mViewThrottling && !hiddenViews.isEmpty()) {
+        if (!mViewTierTimer.isActive()) {
+            mViewTierTimer.start();
+        }
+    } else {
+        mViewTierTimer.stop();
+    }
+}
+
+// Discards least recently shown views until live views fit into the limit.
+void QMozContextPrivate::discardViews(const QList<QMozViewPrivate *> &hiddenViews)
+{
+    int liveViews = 0;
+    for (const QMozViewPrivate *view : mViews) {
+        if (view->mView && !view->mDiscardPending) {
+            ++liveViews;
+        }
+    }
+
+    // hiddenViews is ordered most recently shown first.
+    for (int i = hiddenViews.count() - 1; i >= 0; --i) {
+        if (liveViews <= mLiveViewLimit) {
+            break;
+        }
+        QMozViewPrivate *view = hiddenViews.at(i);
+        if (!view->mIsLoading && view->discard()) {
+            --liveViews;
+        }
+    }
+}
+
+void QMozContextPrivate::trimMemory()
+{
+    const qint64 now = mViewClock.elapsed();
+    if (!IsInitialized() || now - mLastMemoryTrim < MOZCONTEXT_MEMORY_TRIM_INTERVAL) {
+        return;
+    }
+
+    mLastMemoryTrim = now;
+    mApp->SendObserve("memory-pressure", u"heap-minimize");
+}
+
 uint32_t QMozContextPrivate::CreateNewWindowRequested(const uint32_t &chromeFlags, const bool &hidden,
                                                       EmbedLiteView *aParentView, const uintptr_t &parentBrowsingContext)
 {
@@ -282,19 +676,56 @@ QMozContext::QMozContext(QObject *parent)
     connect(d, &QMozContextPrivate::lastViewDestroyed, this, &QMozContext::lastViewDestroyed);
     connect(d, &QMozContextPrivate::lastWindowDestroyed, this, &QMozContext::lastWindowDestroyed);
     connect(d, &QMozContextPrivate::recvObserve, this, &QMozContext::recvObserve);
+    connect(d, &QMozContextPrivate::viewTierChanged, this, &QMozContext::viewTierChanged);
+    connect(d, &QMozContextPrivate::engineLoaded, this, &QMozContext::engineLoaded);
+    connect(d->mViewPool, &QMozViewPool::statsChanged, this, &QMozContext::viewPoolStatsChanged);
+    d->mContexts.append(this);
+}
+
+/*!
+    \fn QFuture<bool> QMozContext::preloadEngine()
+
+    Starts loading the engine library on a background thread. Call this early
+    in main(), after the application object is created, so that the engine
+    loads while QML is being loaded. The context created later completes the
+    startup once loading has finished and emits engineLoaded(). Until then
+    calls that need the engine, including PostUITask(), PostCompositorTask()
+    and CancelTask(), wait for it on the main thread and runEmbedding() is
+    deferred. Called from other threads before engineLoaded() they return
+    without a task.
+*/
+QFuture<bool> QMozContext::preloadEngine()
+{
+    QFuture<bool> &bootstrap = engine_bootstrap();
+    if (!bootstrap.isStarted() && !mozContextPrivateInstance.exists()) {
+        prepare_environment();
+        bootstrap = QtConcurrent::run(load_engine);
+    }
+    return bootstrap;
+}
+
+bool QMozContext::isEngineLoaded() const
+{
+    return d->mApp;
 }
 
 void QMozContext::setProfile(const QString &profilePath)
 {
+    d->waitForBootstrap();
     d->mApp->SetProfilePath(!profilePath.isEmpty() ? profilePath.toUtf8().data() : nullptr);
 }
 
 QMozContext::~QMozContext()
 {
+    // The private instance may already be gone at exit.
+    if (QMozContextPrivate::instance()) {
+        d->mContexts.removeOne(this);
+    }
 }
 
 void QMozContext::addComponentManifest(const QString &manifestPath)
 {
+    d->waitForBootstrap();
     if (!d->mApp)
         return;
     d->mApp->AddManifestLocation(manifestPath.toUtf8().data());
@@ -373,6 +804,30 @@ void QMozContext::removeObservers(const std::vector<std::string> &aObserversList
     }
 }
 
+/*!
+    \fn void QMozContext::subscribe(const QString &topic, QObject *receiver, const ObserverCallback &callback)
+
+    Calls \a callback with the data of every \a topic notification until
+    unsubscribe() is called or \a receiver is destroyed. The topic is
+    observed for as long as it has subscribers.
+
+    Unlike recvObserve(), which is emitted for every observed topic,
+    subscriptions only see the topic they were made for. Payloads are only
+    parsed when the topic has a subscriber or recvObserve() is connected.
+
+    \a callback is called in the thread of \a receiver. When that is not
+    the thread delivering the notification the call is queued.
+*/
+void QMozContext::subscribe(const QString &topic, QObject *receiver, const ObserverCallback &callback)
+{
+    d->subscribe(topic, receiver, callback);
+}
+
+void QMozContext::unsubscribe(const QString &topic, QObject *receiver)
+{
+    d->unsubscribe(topic, receiver);
+}
+
 void QMozContext::notifyObservers(const QString &topic, const QString &value)
 {
     if (!d->IsInitialized()) {
@@ -399,8 +854,8 @@ void QMozContext::notifyObservers(const QString &topic, const QVariant &value)
         doc = QJsonDocument::fromVariant(value);
     }
 
-    QByteArray array = doc.toJson();
-    d->mApp->SendObserve(topic.toUtf8().data(), (const char16_t*)QString(array).constData());
+    const QString data = QString::fromUtf8(doc.toJson(QJsonDocument::Compact));
+    d->mApp->SendObserve(topic.toUtf8().data(), (const char16_t*)data.constData());
 }
 
 int QMozContext::getNumberOfViews() const
@@ -413,8 +868,215 @@ int QMozContext::getNumberOfWindows() const
     return d->mApp ? d->mApp->GetNumberOfWindows() : 0;
 }
 
+/*!
+    \property QMozContext::viewThrottling
+
+    When enabled views are throttled according to their tier. Visible views
+    paint at the full rate and background views at the throttled rate of the
+    refresh driver, views that have been hidden
+    for a while or that fall outside the few most recently shown ones get their
+    timeouts suspended, and frozen views additionally trigger heap minimization.
+    Inactive views always have their docshell deactivated, which pauses media.
+    Disabled by default.
+*/
+bool QMozContext::viewThrottling() const
+{
+    return d->mViewThrottling;
+}
+
+void QMozContext::setViewThrottling(bool enabled)
+{
+    if (d->mViewThrottling == enabled) {
+        return;
+    }
+
+    d->mViewThrottling = enabled;
+    for (QMozViewPrivate *view : d->mViews) {
+        view->applyTier();
+    }
+    d->scheduleViewTierUpdate();
+    Q_EMIT viewThrottlingChanged();
+}
+
+/*!
+    \property QMozContext::liveViewLimit
+
+    Maximum number of views kept live, that is with an engine side view.
+    When there are more the least recently shown inactive views are
+    discarded, see QuickMozView::discard(). This bounds memory use by view
+    count because engine memory is not reported per view. Zero, the default,
+    disables discarding.
+*/
+int QMozContext::liveViewLimit() const
+{
+    return d->mLiveViewLimit;
+}
+
+void QMozContext::setLiveViewLimit(int count)
+{
+    count = qMax(0, count);
+    if (d->mLiveViewLimit != count) {
+        d->mLiveViewLimit = count;
+        d->scheduleViewTierUpdate();
+        Q_EMIT liveViewLimitChanged();
+    }
+}
+
+/*!
+    \property QMozContext::viewPoolSize
+
+    Number of initialized views kept ready for new views that have no parent
+    and are not hidden, such as new tabs. Views that open from another view
+    or start in desktop mode always create a fresh engine view. Pooled views count as live engine
+    views, set the pool size to zero before waiting for lastViewDestroyed.
+    Defaults to zero.
+*/
+int QMozContext::viewPoolSize() const
+{
+    return d->mViewPool->size(false);
+}
+
+void QMozContext::setViewPoolSize(int size)
+{
+    const int oldSize = d->mViewPool->size(false);
+    d->mViewPool->setSize(false, size);
+    if (d->mViewPool->size(false) != oldSize) {
+        Q_EMIT viewPoolSizeChanged();
+    }
+}
+
+/*!
+    \property QMozContext::privateViewPoolSize
+
+    Like viewPoolSize, for views in private browsing mode.
+*/
+int QMozContext::privateViewPoolSize() const
+{
+    return d->mViewPool->size(true);
+}
+
+void QMozContext::setPrivateViewPoolSize(int size)
+{
+    const int oldSize = d->mViewPool->size(true);
+    d->mViewPool->setSize(true, size);
+    if (d->mViewPool->size(true) != oldSize) {
+        Q_EMIT privateViewPoolSizeChanged();
+    }
+}
+
+/*!
+    \fn QVariantMap QMozContext::viewPoolStats() const
+
+    Returns pool hits and misses, the number of available pooled views per
+    mode and the last and average time in milliseconds from view creation to
+    view initialization. Changes are notified with viewPoolStatsChanged().
+*/
+QVariantMap QMozContext::viewPoolStats() const
+{
+    return d->mViewPool->stats();
+}
+
+/*!
+    \fn void QMozContext::addStartupMark(const QString &name)
+
+    Adds an embedder defined mark to the startup timeline.
+*/
+void QMozContext::addStartupMark(const QString &name)
+{
+    d->markStartup(name.toUtf8());
+}
+
+/*!
+    \fn QVariantList QMozContext::startupTimeline(quint32 uniqueId) const
+
+    Returns the startup timeline as a list of marks ordered by time. Each mark
+    has a name, the time in milliseconds since the first mark and the
+    uniqueId of the view it belongs to, zero for context wide marks. When
+    \a uniqueId is non zero only the marks of that view are returned.
+
+    The context records EngineLoadStart, EngineLoaded, ContextCreated,
+    RunEmbedding, Initialized, PreferencesReplayStart, PreferencesReplayed and
+    FirstUIInitialized. Views record CreateView, ViewInitialized, FirstPaint
+    and LoadFinished once each.
+*/
+QVariantList QMozContext::startupTimeline(quint32 uniqueId) const
+{
+    StartupTimeline *timeline = startupTimelineInstance();
+    QMutexLocker lock(&timeline->mutex);
+
+    QVariantList marks;
+    if (timeline->marks.isEmpty()) {
+        return marks;
+    }
+
+    const qint64 origin = timeline->marks.first().timestamp;
+    for (const StartupMark &mark : timeline->marks) {
+        if (uniqueId && mark.viewId != uniqueId) {
+            continue;
+        }
+        QVariantMap entry;
+        entry.insert(QStringLiteral("name"), QString::fromUtf8(mark.name));
+        entry.insert(QStringLiteral("time"), (mark.timestamp - origin) / 1000.0);
+        entry.insert(QStringLiteral("view"), mark.viewId);
+        marks.append(entry);
+    }
+    return marks;
+}
+
+/*!
+    \fn QByteArray QMozContext::startupTrace() const
+
+    Returns the startup timeline in Chrome trace event JSON format.
+*/
+QByteArray QMozContext::startupTrace() const
+{
+    StartupTimeline *timeline = startupTimelineInstance();
+    QMutexLocker lock(&timeline->mutex);
+
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray events;
+    for (const StartupMark &mark : timeline->marks) {
+        QJsonObject event;
+        event.insert(QStringLiteral("name"), QString::fromUtf8(mark.name));
+        event.insert(QStringLiteral("ph"), QStringLiteral("i"));
+        event.insert(QStringLiteral("s"), QStringLiteral("p"));
+        event.insert(QStringLiteral("ts"), double(mark.timestamp));
+        event.insert(QStringLiteral("pid"), double(pid));
+        event.insert(QStringLiteral("tid"), 0);
+        if (mark.viewId) {
+            QJsonObject args;
+            args.insert(QStringLiteral("view"), double(mark.viewId));
+            event.insert(QStringLiteral("args"), args);
+        }
+        events.append(event);
+    }
+
+    QJsonObject trace;
+    trace.insert(QStringLiteral("traceEvents"), events);
+    trace.insert(QStringLiteral("displayTimeUnit"), QStringLiteral("ms"));
+    return QJsonDocument(trace).toJson(QJsonDocument::Compact);
+}
+
+/*!
+    \fn int QMozContext::viewTier(quint32 uniqueId) const
+
+    Returns the QMozContext::ViewTier of the view with \a uniqueId, or -1 if
+    there is no such view. Tiers are tracked even when viewThrottling is
+    disabled.
+*/
+int QMozContext::viewTier(quint32 uniqueId) const
+{
+    for (const QMozViewPrivate *view : d->mViews) {
+        if (view->mView && view->mView->GetUniqueID() == uniqueId) {
+            return view->mTier;
+        }
+    }
+    return -1;
+}
+
 QMozContext::TaskHandle QMozContext::PostUITask(QMozContext::TaskCallback cb, void *data, int timeout)
 {
+    d->waitForBootstrap();
     if (!d->mApp)
         return nullptr;
     return d->mApp->PostTask(cb, data, timeout);
@@ -422,6 +1084,7 @@ QMozContext::TaskHandle QMozContext::PostUITask(QMozContext::TaskCallback cb, vo
 
 QMozContext::TaskHandle QMozContext::PostCompositorTask(QMozContext::TaskCallback cb, void *data, int timeout)
 {
+    d->waitForBootstrap();
     if (!d->mApp)
         return nullptr;
     return d->mApp->PostCompositorTask(cb, data, timeout);
@@ -429,6 +1092,7 @@ QMozContext::TaskHandle QMozContext::PostCompositorTask(QMozContext::TaskCallbac
 
 void QMozContext::CancelTask(QMozContext::TaskHandle handle)
 {
+    d->waitForBootstrap();
     if (!d->mApp)
         return;
     d->mApp->CancelTask(handle);
@@ -436,7 +1100,18 @@ void QMozContext::CancelTask(QMozContext::TaskHandle handle)
 
 void QMozContext::runEmbedding(int aDelay)
 {
+    if (!d->mApp) {
+        QMetaObject::Connection *connection = new QMetaObject::Connection;
+        *connection = connect(d, &QMozContextPrivate::engineLoaded, this, [this, aDelay, connection]() {
+            disconnect(*connection);
+            delete connection;
+            runEmbedding(aDelay);
+        });
+        return;
+    }
+
     if (!d->mEmbedStarted) {
+        d->markStartup("RunEmbedding");
         d->mEmbedStarted = true;
         if (d->mAsyncContext) {
             d->mApp->StartWithCustomPump(EmbedLiteApp::EMBED_THREAD, d->EmbedLoop());
@@ -454,6 +1129,7 @@ bool QMozContext::isInitialized() const
 
 EmbedLiteApp *QMozContext::GetApp()
 {
+    d->waitForBootstrap();
     return d->mApp;
 }
 
@@ -474,6 +1150,7 @@ quint32 QMozContext::createView(const quint32 &parentId, const uintptr_t &parent
 
 void QMozContext::setIsAccelerated(bool aIsAccelerated)
 {
+    d->waitForBootstrap();
     if (!d->mApp)
         return;
 
@@ -493,6 +1170,7 @@ void QMozContext::registerWindow(QMozWindow *window)
         d->destroyWindow();
     }
     d->mMozWindow = window;
+    d->mViewPool->scheduleRefill();
 }
 
 QMozWindow *QMozContext::registeredWindow() const
@@ -504,6 +1182,8 @@ void QMozContext::notifyFirstUIInitialized()
 {
     static bool sCalledOnce = false;
     if (!sCalledOnce) {
+        d->markStartup("FirstUIInitialized");
+        d->waitForBootstrap();
         d->mApp->SendObserve("final-ui-startup", nullptr);
         sCalledOnce = true;
     }
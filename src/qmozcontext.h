@@ -7,9 +7,12 @@
 #define qmozcontext_h
 
 #include <QObject>
+#include <QFuture>
 #include <QVariant>
 #include <QStringList>
 
+#include <functional>
+
 class QMozContextPrivate;
 
 namespace mozilla {
@@ -25,11 +28,26 @@ class QMozContext : public QObject
 {
     Q_OBJECT
     Q_PROPERTY(bool initialized READ isInitialized NOTIFY initialized)
+    Q_PROPERTY(bool viewThrottling READ viewThrottling WRITE setViewThrottling NOTIFY viewThrottlingChanged FINAL)
+    Q_PROPERTY(int liveViewLimit READ liveViewLimit WRITE setLiveViewLimit NOTIFY liveViewLimitChanged FINAL)
+    Q_PROPERTY(int viewPoolSize READ viewPoolSize WRITE setViewPoolSize NOTIFY viewPoolSizeChanged FINAL)
+    Q_PROPERTY(int privateViewPoolSize READ privateViewPoolSize WRITE setPrivateViewPoolSize NOTIFY privateViewPoolSizeChanged FINAL)
 public:
+    enum ViewTier {
+        ForegroundTier,
+        VisibleTier,
+        BackgroundRecentTier,
+        BackgroundOldTier,
+        FrozenTier
+    };
+    Q_ENUM(ViewTier)
+
     typedef void (*TaskCallback)(void *data);
     typedef void *TaskHandle;
+    typedef std::function<void(const QString &topic, const QVariant &data)> ObserverCallback;
 
     static QMozContext *instance();
+    static QFuture<bool> preloadEngine();
 
     explicit QMozContext(QObject *parent = 0);
     virtual ~QMozContext();
@@ -37,6 +55,7 @@ public:
     mozilla::embedlite::EmbedLiteApp *GetApp();
 
     Q_INVOKABLE bool isInitialized() const;
+    bool isEngineLoaded() const;
     Q_INVOKABLE bool isAccelerated() const;
 
     void registerWindow(QMozWindow *window);
@@ -49,15 +68,43 @@ public:
     void addObservers(const std::vector<std::string> &aObserversList);
     void removeObservers(const std::vector<std::string> &aObserversList);
 
+    void subscribe(const QString &topic, QObject *receiver, const ObserverCallback &callback);
+    void unsubscribe(const QString &topic, QObject *receiver);
+
     int getNumberOfViews() const;
     int getNumberOfWindows() const;
 
+    bool viewThrottling() const;
+    void setViewThrottling(bool enabled);
+
+    Q_INVOKABLE int viewTier(quint32 uniqueId) const;
+
+    Q_INVOKABLE void addStartupMark(const QString &name);
+    Q_INVOKABLE QVariantList startupTimeline(quint32 uniqueId = 0) const;
+    Q_INVOKABLE QByteArray startupTrace() const;
+
+    int liveViewLimit() const;
+    void setLiveViewLimit(int count);
+
+    int viewPoolSize() const;
+    void setViewPoolSize(int size);
+    int privateViewPoolSize() const;
+    void setPrivateViewPoolSize(int size);
+    Q_INVOKABLE QVariantMap viewPoolStats() const;
+
 Q_SIGNALS:
     void initialized();
+    void engineLoaded();
     void contextDestroyed();
     void lastViewDestroyed();
     void lastWindowDestroyed();
     void recvObserve(const QString message, const QVariant data);
+    void viewThrottlingChanged();
+    void viewTierChanged(quint32 uniqueId, int tier);
+    void liveViewLimitChanged();
+    void viewPoolSizeChanged();
+    void privateViewPoolSizeChanged();
+    void viewPoolStatsChanged();
 
 public Q_SLOTS:
     void setIsAccelerated(bool aIsAccelerated);
@@ -14,10 +14,17 @@
 #define QMOZCONTEXT_P_H
 
 #include <QObject>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QList>
 #include <QMap>
+#include <QPointer>
 #include <QStringList>
 #include <QThread>
+#include <QTimer>
 #include <QVariant>
+#include <QVector>
 
 #include "qmozwindow.h"
 
@@ -26,6 +33,8 @@
 #endif
 
 class QMozViewCreator;
+class QMozViewPrivate;
+class QMozViewPool;
 class MessagePumpQt;
 
 namespace mozilla {
@@ -47,6 +56,7 @@ class QMozContextPrivate : public QObject
     Q_OBJECT
 public:
     static QMozContextPrivate *instance();
+    static void markStartup(const QByteArray &name, quint32 viewId = 0);
 
     explicit QMozContextPrivate(QObject *parent = 0);
     ~QMozContextPrivate();
@@ -64,19 +74,49 @@ public:
                                       const uintptr_t &parentBrowsingContext) override;
 
     bool IsInitialized();
+    void waitForBootstrap();
     EmbedLiteMessagePump *EmbedLoop();
     void destroyWindow();
 
+    void registerView(QMozViewPrivate *view);
+    void unregisterView(QMozViewPrivate *view);
+    void scheduleViewTierUpdate();
+    bool viewThrottling() const;
+    QMozViewPool *viewPool() const;
+
+    void subscribe(const QString &topic, QObject *receiver, const QMozContext::ObserverCallback &callback);
+    void unsubscribe(const QString &topic, QObject *receiver);
+    bool hasObserveReceivers() const;
+
 Q_SIGNALS:
     void initialized();
     void contextDestroyed();
     void lastViewDestroyed();
     void lastWindowDestroyed();
     void recvObserve(const QString message, const QVariant data);
+    void viewTierChanged(quint32 uniqueId, int tier);
+    void engineLoaded();
+
+private Q_SLOTS:
+    void updateViewTiers();
+    void finishBootstrap();
+    void subscriberDestroyed();
 
 private:
+    struct ObserverSubscription {
+        QPointer<QObject> receiver;
+        QMozContext::ObserverCallback callback;
+    };
+
+    void trimMemory();
+    void discardViews(const QList<QMozViewPrivate *> &hiddenViews);
+
     EmbedLiteApp *mApp;
     std::map<std::string, uint> mObservers;
+    // Per-topic subscribers, see QMozContext::subscribe().
+    QHash<QByteArray, QVector<ObserverSubscription> > mSubscriptions;
+    // QMozContext objects forwarding recvObserve().
+    QList<QMozContext *> mContexts;
 
     bool mInitialized;
     QPointer<QThread> mThread;
@@ -88,7 +128,19 @@ private:
     QPointer<QMozWindow> mMozWindow;
     QMap<QString, QVariant> mInitialPreferences;
 
+    // Background throttling policy
+    QList<QMozViewPrivate *> mViews;
+    bool mViewThrottling;
+    bool mViewTierUpdateScheduled;
+    QTimer mViewTierTimer;
+    QElapsedTimer mViewClock;
+    qint64 mLastMemoryTrim;
+    int mLiveViewLimit;
+    QMozViewPool *mViewPool;
+    QFutureWatcher<bool> mBootstrapWatcher;
+
     friend class QMozContext;
+    friend class QMozViewPool;
 };
 
 #endif // QMOZCONTEXT_P_H
@@ -9,9 +9,12 @@
 
 #include "qmozenginesettings.h"
 #include "qmozenginesettings_p.h"
+#include "qmozcontext_p.h"
 
 #include <QStringList>
 
+#include <algorithm>
+
 #include <mozilla/embedlite/EmbedLiteApp.h>
 
 Q_GLOBAL_STATIC(QMozEngineSettings, engineSettingsInstance)
@@ -35,17 +38,24 @@ const auto PREF_PIXEL_RATIO = QStringLiteral("layout.css.devPixelsPerPx");
 const auto PREF_DO_NOT_TRACK = QStringLiteral("privacy.donottrackheader.enabled");
 const auto PREF_COLOR_MODE =  QStringLiteral("ui.systemUsesDarkTheme");
 
-const QStringList PREF_CHANGED_OBSERVERS = {
-    PREF_PERMISSIONS_DEFAULT_IMAGE,
-    PREF_JAVASCRIPT_ENABLED,
-    PREF_POPUP_DISABLE_DURING_LOAD,
-    PREF_COOKIE_BEHAVIOR,
-    PREF_USE_DOWNLOAD_DIR,
-    PREF_DOWNLOAD_DIR,
-    PREF_PIXEL_RATIO,
-    PREF_DO_NOT_TRACK,
-    PREF_COLOR_MODE
-};
+bool isPreferenceBranch(const QString &name)
+{
+    return name.endsWith(QLatin1Char('.'));
+}
+
+QVariant convertPreference(const QVariant &value, QMozEngineSettings::PreferenceType type)
+{
+    switch (type) {
+    case QMozEngineSettings::BoolPref:
+        return value.toBool();
+    case QMozEngineSettings::IntPref:
+        return value.toInt();
+    case QMozEngineSettings::StringPref:
+        return value.toString();
+    default:
+        return value;
+    }
+}
 }
 
 QMozEngineSettingsPrivate *QMozEngineSettingsPrivate::instance()
@@ -64,7 +74,41 @@ QMozEngineSettingsPrivate::QMozEngineSettingsPrivate(QObject *parent)
     , mPixelRatio(1.0)
     , mDoNotTrack(false)
     , mColorScheme(QMozEngineSettings::FollowsAmbience)
-{
+    , mBatchDepth(0)
+    , mBranchCount(0)
+{
+    addBinding(PREF_PERMISSIONS_DEFAULT_IMAGE, QMozEngineSettings::IntPref, [this](const QVariant &value) {
+        updateValue(mAutoLoadImages, value.toInt() != IMAGE_LOAD_DENY,
+                    &QMozEngineSettingsPrivate::autoLoadImagesChanged);
+    });
+    addBinding(PREF_JAVASCRIPT_ENABLED, QMozEngineSettings::BoolPref, [this](const QVariant &value) {
+        updateValue(mJavascriptEnabled, value.toBool(), &QMozEngineSettingsPrivate::javascriptEnabledChanged);
+    });
+    addBinding(PREF_POPUP_DISABLE_DURING_LOAD, QMozEngineSettings::BoolPref, [this](const QVariant &value) {
+        updateValue(mPopupEnabled, !value.toBool(), &QMozEngineSettingsPrivate::popupEnabledChanged);
+    });
+    addBinding(PREF_COOKIE_BEHAVIOR, QMozEngineSettings::IntPref, [this](const QVariant &value) {
+        updateValue(mCookieBehavior, intToCookieBehavior(value.toInt()),
+                    &QMozEngineSettingsPrivate::cookieBehaviorChanged);
+    });
+    addBinding(PREF_USE_DOWNLOAD_DIR, QMozEngineSettings::BoolPref, [this](const QVariant &value) {
+        updateValue(mUseDownloadDir, value.toBool(), &QMozEngineSettingsPrivate::useDownloadDirChanged);
+    });
+    addBinding(PREF_DOWNLOAD_DIR, QMozEngineSettings::StringPref, [this](const QVariant &value) {
+        updateValue(mDownloadDir, value.toString(), &QMozEngineSettingsPrivate::downloadDirChanged);
+    });
+    addBinding(PREF_PIXEL_RATIO, QMozEngineSettings::UnknownPref, [this](const QVariant &value) {
+        updateValue(mPixelRatio, value.toReal(), &QMozEngineSettingsPrivate::pixelRatioChanged);
+    });
+    addBinding(PREF_DO_NOT_TRACK, QMozEngineSettings::BoolPref, [this](const QVariant &value) {
+        updateValue(mDoNotTrack, value.toBool(), &QMozEngineSettingsPrivate::doNotTrackChanged);
+    });
+    // An empty value means that the pref is not set and the ambience decides.
+    addBinding(PREF_COLOR_MODE, QMozEngineSettings::UnknownPref, [this](const QVariant &value) {
+        updateValue(mColorScheme, value.toString().isEmpty() ? QMozEngineSettings::FollowsAmbience
+                                                            : intToColorScheme(value.toInt()),
+                    &QMozEngineSettingsPrivate::colorSchemeChanged);
+    });
 
     QMozContext *context = QMozContext::instance();
     if (context->isInitialized()) {
@@ -72,8 +116,9 @@ QMozEngineSettingsPrivate::QMozEngineSettingsPrivate(QObject *parent)
     } else {
         connect(context, &QMozContext::initialized, this, &QMozEngineSettingsPrivate::initialize);
     }
-    connect(context, &QMozContext::recvObserve, this, &QMozEngineSettingsPrivate::onObserve);
-    context->addObserver(NS_PREF_CHANGED);
+    context->subscribe(NS_PREF_CHANGED, this, [this](const QString &topic, const QVariant &data) {
+        onObserve(topic, data);
+    });
 }
 
 QMozEngineSettingsPrivate::~QMozEngineSettingsPrivate()
@@ -228,7 +273,7 @@ void QMozEngineSettingsPrivate::enableLowPrecisionBuffers(bool enabled)
 void QMozEngineSettingsPrivate::setPreference(const QString &key, const QVariant &value,
                                               QMozEngineSettings::PreferenceType preferenceType)
 {
-    qCDebug(lcEmbedLiteExt) << "name:" << key.toUtf8().data() << ", type:" << value.type() << ", user type:" << value.userType();
+    qCDebug(lcEmbedLiteExt) << "name:" << key << ", type:" << value.type() << ", user type:" << value.userType();
 
     if (!isInitialized()) {
         qCDebug(lcEmbedLiteExt) << "Error: context not yet initialized";
@@ -236,17 +281,72 @@ void QMozEngineSettingsPrivate::setPreference(const QString &key, const QVariant
         return;
     }
 
+    if (mBatchDepth > 0) {
+        if (!mBatch.contains(key)) {
+            mBatchOrder.append(key);
+        }
+        mBatch.insert(key, qMakePair(value, preferenceType));
+        return;
+    }
+
+    applyPreference(QMozContext::instance()->GetApp(), key.toUtf8(), value, preferenceType);
+}
+
+/*
+ * Preferences set between beginBatch() and the matching commit() are
+ * collected and sent in one pass on commit, in the order they were first
+ * set. A key set several times is sent once with its last value. Batches
+ * nest.
+ */
+void QMozEngineSettingsPrivate::beginBatch()
+{
+    ++mBatchDepth;
+}
+
+void QMozEngineSettingsPrivate::commit()
+{
+    if (mBatchDepth == 0) {
+        qCWarning(lcEmbedLiteExt) << "Preference batch committed without beginBatch()";
+        return;
+    }
+
+    if (--mBatchDepth > 0 || mBatch.isEmpty()) {
+        return;
+    }
+
     mozilla::embedlite::EmbedLiteApp *app = QMozContext::instance()->GetApp();
+    QStringList order;
+    order.swap(mBatchOrder);
+    QHash<QString, QPair<QVariant, QMozEngineSettings::PreferenceType> > batch;
+    batch.swap(mBatch);
+    for (const QString &key : order) {
+        const QPair<QVariant, QMozEngineSettings::PreferenceType> &preference = batch[key];
+        applyPreference(app, key.toUtf8(), preference.first, preference.second);
+    }
+}
 
+void QMozEngineSettingsPrivate::setPreferences(const QVariantMap &preferences)
+{
+    beginBatch();
+    for (auto it = preferences.constBegin(); it != preferences.constEnd(); ++it) {
+        setPreference(it.key(), it.value());
+    }
+    commit();
+}
+
+void QMozEngineSettingsPrivate::applyPreference(mozilla::embedlite::EmbedLiteApp *app, const QByteArray &key,
+                                                const QVariant &value,
+                                                QMozEngineSettings::PreferenceType preferenceType)
+{
     switch (preferenceType) {
     case QMozEngineSettings::BoolPref:
-        app->SetBoolPref(key.toUtf8().data(), value.toBool());
+        app->SetBoolPref(key.constData(), value.toBool());
         break;
     case QMozEngineSettings::StringPref:
-        app->SetCharPref(key.toUtf8().data(), value.toString().toUtf8().data());
+        app->SetCharPref(key.constData(), value.toString().toUtf8().constData());
         break;
     case QMozEngineSettings::IntPref:
-        app->SetIntPref(key.toUtf8().data(), value.toInt());
+        app->SetIntPref(key.constData(), value.toInt());
         break;
     default:
         int type = value.type();
@@ -254,16 +354,16 @@ void QMozEngineSettingsPrivate::setPreference(const QString &key, const QVariant
         case QMetaType::QString:
         case QMetaType::Float:
         case QMetaType::Double:
-            app->SetCharPref(key.toUtf8().data(), value.toString().toUtf8().data());
+            app->SetCharPref(key.constData(), value.toString().toUtf8().constData());
             break;
         case QMetaType::Int:
         case QMetaType::UInt:
         case QMetaType::LongLong:
         case QMetaType::ULongLong:
-            app->SetIntPref(key.toUtf8().data(), value.toInt());
+            app->SetIntPref(key.constData(), value.toInt());
             break;
         case QMetaType::Bool:
-            app->SetBoolPref(key.toUtf8().data(), value.toBool());
+            app->SetBoolPref(key.constData(), value.toBool());
             break;
         default:
             qCWarning(lcEmbedLiteExt) << "Unknown pref" << key << "value" << value << "type:" << value.type()
@@ -300,94 +400,159 @@ int QMozEngineSettingsPrivate::colorSchemeToInt(QMozEngineSettings::ColorScheme
 
 void QMozEngineSettingsPrivate::onObserve(const QString &topic, const QVariant &data)
 {
-    if (topic == NS_PREF_CHANGED) {
-        QVariantMap dataMap = data.toMap();
-        QString changedPreference = dataMap.value(QStringLiteral("name")).toString();
-        QVariant preferenceValue = dataMap.value(QStringLiteral("value"));
-        if (PREF_CHANGED_OBSERVERS.contains(changedPreference)) {
-            if (changedPreference == PREF_PERMISSIONS_DEFAULT_IMAGE) {
-                bool imageLoadingAllowed = !(preferenceValue.toInt() == IMAGE_LOAD_DENY);
-                if (mAutoLoadImages != imageLoadingAllowed) {
-                    mAutoLoadImages = imageLoadingAllowed;
-                    Q_EMIT autoLoadImagesChanged();
-                }
-            } else if (changedPreference == PREF_JAVASCRIPT_ENABLED) {
-                bool jsEnabled = preferenceValue.toBool();
-                if (mJavascriptEnabled != jsEnabled) {
-                    mJavascriptEnabled = jsEnabled;
-                    Q_EMIT javascriptEnabledChanged();
-                }
-            } else if (changedPreference == PREF_POPUP_DISABLE_DURING_LOAD) {
-                bool popupEnabled = !preferenceValue.toBool();
-                if (mPopupEnabled != popupEnabled) {
-                    mPopupEnabled = popupEnabled;
-                    Q_EMIT popupEnabledChanged();
-                }
-            } else if (changedPreference == PREF_COOKIE_BEHAVIOR) {
-                QMozEngineSettings::CookieBehavior behavior = intToCookieBehavior(preferenceValue.toInt());
-                if (mCookieBehavior != behavior) {
-                    mCookieBehavior = behavior;
-                    Q_EMIT cookieBehaviorChanged();
-                }
-            } else if (changedPreference == PREF_USE_DOWNLOAD_DIR) {
-                bool useDownloadDir = preferenceValue.toBool();
-                if (mUseDownloadDir != useDownloadDir) {
-                    mUseDownloadDir = useDownloadDir;
-                    Q_EMIT useDownloadDirChanged();
-                }
-            } else if (changedPreference == PREF_DOWNLOAD_DIR) {
-                QString downloadDir = preferenceValue.toString();
-                if (mDownloadDir != downloadDir) {
-                    mDownloadDir = downloadDir;
-                    Q_EMIT downloadDirChanged();
-                }
-            } else if (changedPreference == PREF_PIXEL_RATIO) {
-                qreal ratio = preferenceValue.toReal();
-                if (mPixelRatio != ratio) {
-                    mPixelRatio = ratio;
-                    Q_EMIT pixelRatioChanged();
-                }
-            } else if (changedPreference == PREF_DO_NOT_TRACK) {
-                bool doNotTrack = preferenceValue.toBool();
-                if (mDoNotTrack != doNotTrack) {
-                    mDoNotTrack = doNotTrack;
-                    Q_EMIT doNotTrackChanged();
-                }
-            } else if (changedPreference == PREF_COLOR_MODE) {
-                QMozEngineSettings::ColorScheme colorScheme = QMozEngineSettings::FollowsAmbience;
-                if (!preferenceValue.toString().isEmpty()) {
-                    colorScheme = intToColorScheme((preferenceValue.toInt()));
-                }
-                if (mColorScheme != colorScheme) {
-                    mColorScheme = colorScheme;
-                    Q_EMIT colorSchemeChanged();
-                }
-            }
+    if (topic != NS_PREF_CHANGED) {
+        return;
+    }
+
+    QVariantMap dataMap = data.toMap();
+    QString changedPreference = dataMap.value(QStringLiteral("name")).toString();
+    auto binding = findBinding(changedPreference);
+    if (binding == mBindings.constEnd()) {
+        return;
+    }
+
+    QVariant value = convertPreference(dataMap.value(QStringLiteral("value")), binding->type);
+    if (binding->update) {
+        binding->update(value);
+    }
+
+    auto cached = mPreferenceValues.find(changedPreference);
+    if (cached == mPreferenceValues.end() || *cached != value) {
+        mPreferenceValues.insert(changedPreference, value);
+        Q_EMIT preferenceChanged(changedPreference, value);
+    }
+}
+
+/*
+ * Bindings are keyed by pref name, or by a branch prefix ending in a dot
+ * which then covers every pref below it. A change notification is resolved
+ * with a hash lookup of the name followed by one lookup per parent branch.
+ */
+QHash<QString, QMozEngineSettingsPrivate::PreferenceBinding>::const_iterator
+QMozEngineSettingsPrivate::findBinding(const QString &name) const
+{
+    auto binding = mBindings.constFind(name);
+    if (binding != mBindings.constEnd() || mBranchCount == 0) {
+        return binding;
+    }
+
+    for (int dot = name.lastIndexOf(QLatin1Char('.')); dot > 0; dot = name.lastIndexOf(QLatin1Char('.'), dot - 1)) {
+        binding = mBindings.constFind(name.left(dot + 1));
+        if (binding != mBindings.constEnd()) {
+            return binding;
         }
     }
+    return mBindings.constEnd();
+}
+
+void QMozEngineSettingsPrivate::addBinding(const QString &name, QMozEngineSettings::PreferenceType type,
+                                           const std::function<void(const QVariant &)> &update)
+{
+    auto binding = mBindings.find(name);
+    if (binding != mBindings.end()) {
+        // Built-in bindings keep their own type.
+        if (!binding->update) {
+            binding->type = type;
+        }
+        return;
+    }
+
+    mBindings.insert(name, PreferenceBinding { type, update });
+    if (isPreferenceBranch(name)) {
+        ++mBranchCount;
+    }
+
+    if (mInitialized) {
+        addObserver(name);
+    }
+}
+
+// Gecko reports the current value when an observer is added.
+void QMozEngineSettingsPrivate::addObserver(const QString &name)
+{
+    bool observed = mObservedPreferences.contains(name);
+
+    // A pref below an observed branch is already covered by its observer.
+    for (int dot = name.lastIndexOf(QLatin1Char('.'), -2); dot > 0 && !observed;
+         dot = name.lastIndexOf(QLatin1Char('.'), dot - 1)) {
+        observed = mObservedPreferences.contains(name.left(dot + 1));
+    }
+
+    if (!observed) {
+        mObservedPreferences.insert(name);
+        requestPreference(name);
+    } else if (!isPreferenceBranch(name)) {
+        // Rebound or covered by a branch, the value cache still needs seeding.
+        requestPreference(name);
+    }
+}
+
+// Gecko answers an added observer with the current value. Adding one again
+// is the only way to ask for a value, repeated notifications of an already
+// observed pref are filtered against mPreferenceValues in onObserve().
+void QMozEngineSettingsPrivate::requestPreference(const QString &key)
+{
+    QVariantMap data;
+    data.insert(QStringLiteral("name"), key);
+    QMozContext::instance()->notifyObservers(QStringLiteral("embed:addPrefChangedObserver"), data);
+}
+
+void QMozEngineSettingsPrivate::bindPreference(const QString &name, QMozEngineSettings::PreferenceType type)
+{
+    if (name.isEmpty()) {
+        return;
+    }
+
+    addBinding(name, type, nullptr);
+}
+
+void QMozEngineSettingsPrivate::unbindPreference(const QString &name)
+{
+    auto binding = mBindings.find(name);
+    if (binding == mBindings.end() || binding->update) {
+        return;
+    }
+
+    if (isPreferenceBranch(name)) {
+        --mBranchCount;
+    }
+    mBindings.erase(binding);
+
+    for (auto it = mPreferenceValues.begin(); it != mPreferenceValues.end();) {
+        if (findBinding(it.key()) == mBindings.constEnd()) {
+            it = mPreferenceValues.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+QVariant QMozEngineSettingsPrivate::preference(const QString &name) const
+{
+    return mPreferenceValues.value(name);
 }
 
 void QMozEngineSettingsPrivate::initialize()
 {
-    QMozContext *context = QMozContext::instance();
+    QMozContextPrivate::markStartup("PreferencesReplayStart");
 
     // Add preference change observers and request preference value.
-    for (const auto &pref : PREF_CHANGED_OBSERVERS) {
-        QVariantMap data;
-        data.insert(QStringLiteral("name"), pref);
-        context->notifyObservers(QStringLiteral("embed:addPrefChangedObserver"), data);
+    // Branches go first so that prefs below them need no observer of their own.
+    QStringList names = mBindings.keys();
+    std::sort(names.begin(), names.end(), [](const QString &a, const QString &b) {
+        return a.length() < b.length();
+    });
+    for (const QString &name : names) {
+        addObserver(name);
     }
 
     mInitialized = true;
     setDefaultPreferences();
 
     // Apply initial preferences.
-    QMapIterator<QString, QVariant> preferenceIterator(mPreferences);
-    while (preferenceIterator.hasNext()) {
-        preferenceIterator.next();
-        setPreference(preferenceIterator.key(), preferenceIterator.value());
-    }
+    setPreferences(mPreferences);
     disconnect(QMozContext::instance(), &QMozContext::initialized, this, &QMozEngineSettingsPrivate::initialize);
+    QMozContextPrivate::markStartup("PreferencesReplayed");
 
     Q_EMIT initialized();
 }
@@ -435,6 +600,7 @@ QMozEngineSettings::QMozEngineSettings(QObject *parent)
     connect(d, &QMozEngineSettingsPrivate::pixelRatioChanged, this, &QMozEngineSettings::pixelRatioChanged);
     connect(d, &QMozEngineSettingsPrivate::doNotTrackChanged, this, &QMozEngineSettings::doNotTrackChanged);
     connect(d, &QMozEngineSettingsPrivate::colorSchemeChanged, this, &QMozEngineSettings::colorSchemeChanged);
+    connect(d, &QMozEngineSettingsPrivate::preferenceChanged, this, &QMozEngineSettings::preferenceChanged);
 }
 
 QMozEngineSettings::~QMozEngineSettings()
@@ -584,3 +750,67 @@ void QMozEngineSettings::setPreference(const QString &key, const QVariant &value
     Q_D(QMozEngineSettings);
     d->setPreference(key, value, preferenceType);
 }
+
+/*!
+    \fn void QMozEngineSettings::setPreferences(const QVariantMap &preferences)
+
+    Sets all \a preferences in one batch, see beginBatch().
+*/
+void QMozEngineSettings::setPreferences(const QVariantMap &preferences)
+{
+    Q_D(QMozEngineSettings);
+    d->setPreferences(preferences);
+}
+
+/*!
+    \fn void QMozEngineSettings::beginBatch()
+
+    Starts collecting preference changes instead of sending each one to the
+    engine. The collected changes are sent together by the matching commit().
+    Property setters of this class go through the batch too.
+*/
+void QMozEngineSettings::beginBatch()
+{
+    Q_D(QMozEngineSettings);
+    d->beginBatch();
+}
+
+void QMozEngineSettings::commit()
+{
+    Q_D(QMozEngineSettings);
+    d->commit();
+}
+
+/*!
+    \fn void QMozEngineSettings::bindPreference(const QString &name, PreferenceType type)
+
+    Keeps a local copy of the engine preference \a name, converted to \a type,
+    that is updated whenever the preference changes in the engine. A \a name
+    ending in a dot binds every preference of that branch.
+
+    The current value can then be read with preference() without a round trip
+    to the engine and changes are reported by preferenceChanged().
+*/
+void QMozEngineSettings::bindPreference(const QString &name, PreferenceType type)
+{
+    Q_D(QMozEngineSettings);
+    d->bindPreference(name, type);
+}
+
+void QMozEngineSettings::unbindPreference(const QString &name)
+{
+    Q_D(QMozEngineSettings);
+    d->unbindPreference(name);
+}
+
+/*!
+    \fn QVariant QMozEngineSettings::preference(const QString &name) const
+
+    Returns the last known value of the bound preference \a name or an invalid
+    QVariant if the engine has not reported it yet.
+*/
+QVariant QMozEngineSettings::preference(const QString &name) const
+{
+    Q_D(const QMozEngineSettings);
+    return d->preference(name);
+}
@@ -14,6 +14,7 @@
 
 #include <QObject>
 #include <QSize>
+#include <QVariant>
 
 class QMozEngineSettingsPrivate;
 
@@ -102,6 +103,13 @@ public:
     // Low-level API to set engine preferences.
     Q_INVOKABLE void setPreference(const QString &key, const QVariant &value);
     Q_INVOKABLE void setPreference(const QString &key, const QVariant &value, PreferenceType preferenceType);
+    Q_INVOKABLE void setPreferences(const QVariantMap &preferences);
+    Q_INVOKABLE void beginBatch();
+    Q_INVOKABLE void commit();
+
+    Q_INVOKABLE void bindPreference(const QString &name, PreferenceType type = UnknownPref);
+    Q_INVOKABLE void unbindPreference(const QString &name);
+    Q_INVOKABLE QVariant preference(const QString &name) const;
 
 Q_SIGNALS:
     void autoLoadImagesChanged();
@@ -114,6 +122,7 @@ Q_SIGNALS:
     void pixelRatioChanged();
     void doNotTrackChanged();
     void colorSchemeChanged();
+    void preferenceChanged(const QString &name, const QVariant &value);
 
 private:
     QMozEngineSettingsPrivate *d_ptr;
@@ -13,10 +13,24 @@
 #define QMOZENGINE_SETTINGS_P_H
 
 #include <QObject>
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+
+#include <functional>
+
 #include "qmozenginesettings.h"
 #include "qmozcontext.h"
 #include "qmozembedlog.h"
 
+namespace mozilla {
+namespace embedlite {
+class EmbedLiteApp;
+}
+}
+
 class QMozEngineSettingsPrivate : public QObject
 {
     Q_OBJECT
@@ -64,6 +78,13 @@ public:
     void setPreference(const QString &key, const QVariant &value,
                        QMozEngineSettings::PreferenceType preferenceType = QMozEngineSettings::UnknownPref);
     void requestPreference(const QString &key);
+    void setPreferences(const QVariantMap &preferences);
+    void beginBatch();
+    void commit();
+
+    void bindPreference(const QString &name, QMozEngineSettings::PreferenceType type);
+    void unbindPreference(const QString &name);
+    QVariant preference(const QString &name) const;
 
     bool isInitialized() const;
 
@@ -88,9 +109,31 @@ Q_SIGNALS:
     void pixelRatioChanged();
     void doNotTrackChanged();
     void colorSchemeChanged();
+    void preferenceChanged(const QString &name, const QVariant &value);
 
 private:
+    struct PreferenceBinding {
+        QMozEngineSettings::PreferenceType type;
+        // Set for the prefs backing properties of this class.
+        std::function<void(const QVariant &)> update;
+    };
+
+    template <typename T>
+    void updateValue(T &member, const T &value, void (QMozEngineSettingsPrivate::*changed)())
+    {
+        if (member != value) {
+            member = value;
+            Q_EMIT (this->*changed)();
+        }
+    }
+
+    void addBinding(const QString &name, QMozEngineSettings::PreferenceType type,
+                    const std::function<void(const QVariant &)> &update);
+    QHash<QString, PreferenceBinding>::const_iterator findBinding(const QString &name) const;
+    void addObserver(const QString &name);
     void setDefaultPreferences();
+    static void applyPreference(mozilla::embedlite::EmbedLiteApp *app, const QByteArray &key,
+                                const QVariant &value, QMozEngineSettings::PreferenceType preferenceType);
     QMap<QString, QVariant> mPreferences;
     bool mInitialized;
     bool mJavascriptEnabled;
@@ -102,6 +145,14 @@ private:
     QString mDownloadDir;
     bool mDoNotTrack;
     QMozEngineSettings::ColorScheme mColorScheme;
+    int mBatchDepth;
+    // Batched keys in the order they were first set, and their last values.
+    QStringList mBatchOrder;
+    QHash<QString, QPair<QVariant, QMozEngineSettings::PreferenceType> > mBatch;
+    QHash<QString, PreferenceBinding> mBindings;
+    int mBranchCount;
+    QSet<QString> mObservedPreferences;
+    QHash<QString, QVariant> mPreferenceValues;
 };
 
 #endif // QMOZENGINE_SETTINGS_P_H
@@ -38,6 +38,7 @@ static Qt::ScreenOrientation resolvedOrientation(Qt::ScreenOrientation orientati
 MozMaterialNode::MozMaterialNode()
     : m_orientation(qApp->primaryScreen()->primaryOrientation())
     , m_surfaceOrientation(qApp->primaryScreen()->primaryOrientation())
+    , m_frameOrientation(qApp->primaryScreen()->primaryOrientation())
 {
     setFlag(UsePreprocess);
 
@@ -88,6 +89,22 @@ void MozMaterialNode::setSurfaceOrientation(Qt::ScreenOrientation orientation)
     }
 }
 
+Qt::ScreenOrientation MozMaterialNode::frameOrientation() const
+{
+    return m_frameOrientation;
+}
+
+// The content orientation the texture was rendered for. While it lags behind
+// orientation() the last frame is shown rotated as a preview of the change.
+void MozMaterialNode::setFrameOrientation(Qt::ScreenOrientation orientation)
+{
+    orientation = resolvedOrientation(orientation);
+    if (m_frameOrientation != orientation) {
+        m_frameOrientation = orientation;
+        m_geometryChanged = true;
+    }
+}
+
 QSGTexture *MozMaterialNode::texture() const
 {
     return m_texture;
@@ -148,8 +165,18 @@ void MozMaterialNode::preprocess()
         // windows are already presented in their content orientation, unlike
         // the browser's primary-orientation GL surface.
         int rotation = qApp->primaryScreen()->angleBetween(
-                    resolvedOrientation(m_orientation),
+                    m_frameOrientation,
                     resolvedOrientation(m_surfaceOrientation));
+
+        // Until Gecko has laid out for the new orientation the last frame is
+        // rotated into it, letterboxed to keep its aspect ratio.
+        if (qApp->primaryScreen()->angleBetween(m_frameOrientation, resolvedOrientation(m_orientation)) % 180 != 0) {
+            QSizeF frameSize = geometryRect.size().transposed();
+            frameSize.scale(geometryRect.size(), Qt::KeepAspectRatio);
+            QRectF frameRect(QPointF(), frameSize);
+            frameRect.moveCenter(geometryRect.center());
+            geometryRect = frameRect;
+        }
         switch (rotation) {
         case 90:
             updateRectGeometry(
@@ -30,6 +30,9 @@ public:
     Qt::ScreenOrientation surfaceOrientation() const;
     void setSurfaceOrientation(Qt::ScreenOrientation orientation);
 
+    Qt::ScreenOrientation frameOrientation() const;
+    void setFrameOrientation(Qt::ScreenOrientation orientation);
+
     QSGTexture *texture() const;
     virtual void setTexture(QSGTexture *texture);
 
@@ -42,6 +45,7 @@ private:
     QSGTexture *m_texture = nullptr;
     Qt::ScreenOrientation m_orientation;
     Qt::ScreenOrientation m_surfaceOrientation;
+    Qt::ScreenOrientation m_frameOrientation;
     bool m_geometryChanged = true;
     bool m_textureChanged = true;
 };
@@ -9,7 +9,11 @@
 #include "qmozexttexture.h"
 
 #include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
 #include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QAtomicInt>
+#include <QtMath>
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
@@ -90,3 +94,220 @@ bool QMozExtTexture::updateTexture()
 
     return changed;
 }
+
+namespace {
+
+const GLuint SnapshotVertexAttribute = 0;
+
+QAtomicInt sSnapshotBytes;
+
+/*
+ * Returns the snapshot program of the current context, linking it the first
+ * time. The program is a child of the context so Qt frees it along with it.
+ */
+QOpenGLShaderProgram *snapshotProgram()
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (!context) {
+        return nullptr;
+    }
+
+    const QString name = QStringLiteral("qtmozembed-snapshot-program");
+    QOpenGLShaderProgram *program = context->findChild<QOpenGLShaderProgram *>(name, Qt::FindDirectChildrenOnly);
+    if (program) {
+        return program->isLinked() ? program : nullptr;
+    }
+
+    program = new QOpenGLShaderProgram(context);
+    program->setObjectName(name);
+    program->addShaderFromSourceCode(QOpenGLShader::Vertex,
+            "attribute highp vec2 aVertex;                              \n"
+            "varying highp vec2 vTexCoord;                              \n"
+            "void main() {                                              \n"
+            "    gl_Position = vec4(aVertex * 2.0 - 1.0, 0.0, 1.0);     \n"
+            "    vTexCoord = aVertex;                                   \n"
+            "}");
+    program->addShaderFromSourceCode(QOpenGLShader::Fragment,
+            "#extension GL_OES_EGL_image_external : require            \n"
+            "uniform lowp samplerExternalOES texture;                   \n"
+            "varying highp vec2 vTexCoord;                              \n"
+            "void main() {                                              \n"
+            "    gl_FragColor = texture2D(texture, vTexCoord);          \n"
+            "}");
+    program->bindAttributeLocation("aVertex", SnapshotVertexAttribute);
+    // A program that fails to link stays cached so it is not retried every frame.
+    return program->link() ? program : nullptr;
+}
+
+// Saves the GL state touched while taking a snapshot and restores it when
+// going out of scope. Snapshots are taken from updatePaintNode so the scene
+// graph renderer must find its state untouched.
+class SnapshotStateSaver
+{
+public:
+    SnapshotStateSaver()
+        : context(QOpenGLContext::currentContext())
+    {
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+        glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+        glActiveTexture(GL_TEXTURE0);
+        glGetIntegerv(GL_TEXTURE_BINDING_EXTERNAL_OES, &texture);
+        glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &arrayBuffer);
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glGetVertexAttribiv(SnapshotVertexAttribute, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &attributeEnabled);
+        blend = glIsEnabled(GL_BLEND);
+        scissor = glIsEnabled(GL_SCISSOR_TEST);
+        depth = glIsEnabled(GL_DEPTH_TEST);
+        stencil = glIsEnabled(GL_STENCIL_TEST);
+    }
+
+    ~SnapshotStateSaver()
+    {
+        // Rebind the default framebuffer through QOpenGLFramebufferObject so
+        // that Qt's idea of the bound framebuffer, which bind() changed, stays
+        // right for the scene graph renderer. Any other framebuffer was bound
+        // outside of Qt's tracking and is restored as found.
+        if (GLuint(framebuffer) == context->defaultFramebufferObject()) {
+            QOpenGLFramebufferObject::bindDefault();
+        } else {
+            context->functions()->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        }
+        glUseProgram(program);
+        glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture);
+        glActiveTexture(activeTexture);
+        glBindBuffer(GL_ARRAY_BUFFER, arrayBuffer);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        if (attributeEnabled) {
+            glEnableVertexAttribArray(SnapshotVertexAttribute);
+        } else {
+            glDisableVertexAttribArray(SnapshotVertexAttribute);
+        }
+        restore(GL_BLEND, blend);
+        restore(GL_SCISSOR_TEST, scissor);
+        restore(GL_DEPTH_TEST, depth);
+        restore(GL_STENCIL_TEST, stencil);
+    }
+
+private:
+    static void restore(GLenum capability, GLboolean enabled)
+    {
+        if (enabled) {
+            glEnable(capability);
+        } else {
+            glDisable(capability);
+        }
+    }
+
+    QOpenGLContext *context;
+    GLint framebuffer = 0;
+    GLint program = 0;
+    GLint activeTexture = GL_TEXTURE0;
+    GLint texture = 0;
+    GLint arrayBuffer = 0;
+    GLint viewport[4] = { 0, 0, 0, 0 };
+    GLint attributeEnabled = GL_FALSE;
+    GLboolean blend = GL_FALSE;
+    GLboolean scissor = GL_FALSE;
+    GLboolean depth = GL_FALSE;
+    GLboolean stencil = GL_FALSE;
+};
+
+}
+
+/*
+ * Copies the current frame into a new 2D texture on the GPU, scaled down so that
+ * it takes at most \a maxBytes. Returns null if there is no frame.
+ */
+QMozSnapshotTexture *QMozExtTexture::createSnapshot(int maxBytes) const
+{
+    if (m_textureId == 0 || m_textureSize.isEmpty() || maxBytes <= 0) {
+        return nullptr;
+    }
+
+    QSize size = m_textureSize;
+    const qreal scale = qSqrt(qreal(maxBytes) / (4.0 * size.width() * size.height()));
+    if (scale < 1) {
+        size = (QSizeF(size) * scale).toSize().expandedTo(QSize(1, 1));
+    }
+
+    QOpenGLShaderProgram *program = snapshotProgram();
+    if (!program) {
+        return nullptr;
+    }
+
+    SnapshotStateSaver stateSaver;
+
+    QOpenGLFramebufferObject *framebuffer = new QOpenGLFramebufferObject(size);
+    if (!framebuffer->isValid() || !framebuffer->bind()) {
+        delete framebuffer;
+        return nullptr;
+    }
+
+    static const GLfloat vertices[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+
+    glViewport(0, 0, size.width(), size.height());
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_STENCIL_TEST);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    program->bind();
+    program->setUniformValue("texture", 0);
+    program->enableAttributeArray(SnapshotVertexAttribute);
+    program->setAttributeArray(SnapshotVertexAttribute, GL_FLOAT, vertices, 2);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_EXTERNAL_OES, m_textureId);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    return new QMozSnapshotTexture(framebuffer);
+}
+
+QMozSnapshotTexture::QMozSnapshotTexture(QOpenGLFramebufferObject *framebuffer)
+    : m_framebuffer(framebuffer)
+{
+    sSnapshotBytes.fetchAndAddRelaxed(byteCount());
+}
+
+QMozSnapshotTexture::~QMozSnapshotTexture()
+{
+    sSnapshotBytes.fetchAndAddRelaxed(-byteCount());
+}
+
+int QMozSnapshotTexture::textureId() const
+{
+    return m_framebuffer->texture();
+}
+
+QSize QMozSnapshotTexture::textureSize() const
+{
+    return m_framebuffer->size();
+}
+
+bool QMozSnapshotTexture::hasAlphaChannel() const
+{
+    return false;
+}
+
+bool QMozSnapshotTexture::hasMipmaps() const
+{
+    return false;
+}
+
+void QMozSnapshotTexture::bind()
+{
+    glBindTexture(GL_TEXTURE_2D, m_framebuffer->texture());
+    updateBindOptions();
+}
+
+int QMozSnapshotTexture::byteCount() const
+{
+    const QSize size = m_framebuffer->size();
+    return 4 * size.width() * size.height();
+}
+
+int QMozSnapshotTexture::totalByteCount()
+{
+    return sSnapshotBytes.loadAcquire();
+}
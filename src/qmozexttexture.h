@@ -10,9 +10,16 @@
 #ifndef QMOZEXTTEXTURE_H
 #define QMOZEXTTEXTURE_H
 
+#include <QScopedPointer>
 #include <QSGDynamicTexture>
 #include <functional>
 
+QT_BEGIN_NAMESPACE
+class QOpenGLFramebufferObject;
+QT_END_NAMESPACE
+
+class QMozSnapshotTexture;
+
 class QMozExtTexture : public QSGDynamicTexture
 {
     Q_OBJECT
@@ -30,6 +37,8 @@ public:
     void bind() override;
     bool updateTexture() override;
 
+    QMozSnapshotTexture *createSnapshot(int maxBytes) const;
+
 Q_SIGNALS:
     void getPlatformImage(const std::function<void(void *image, int width, int height)> &callback);
 
@@ -39,4 +48,28 @@ private:
     uint m_textureId = 0;
 };
 
+// Copy of a frame in a regular 2D texture, with the same bottom-left origin as
+// QMozExtTexture. Must be created and deleted on the render thread.
+class QMozSnapshotTexture : public QSGTexture
+{
+    Q_OBJECT
+public:
+    explicit QMozSnapshotTexture(QOpenGLFramebufferObject *framebuffer);
+    ~QMozSnapshotTexture();
+
+    int textureId() const override;
+    QSize textureSize() const override;
+    bool hasAlphaChannel() const override;
+    bool hasMipmaps() const override;
+
+    void bind() override;
+
+    int byteCount() const;
+    // Memory taken by all live snapshots of the process.
+    static int totalByteCount();
+
+private:
+    QScopedPointer<QOpenGLFramebufferObject> m_framebuffer;
+};
+
 #endif
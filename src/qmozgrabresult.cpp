@@ -11,20 +11,292 @@
 #include "qmozopenglwebpage.h"
 #include "qmozgrabresult.h"
 #include "qmozwindow.h"
+#include "qmozview_p.h"
+#include "quickmozview.h"
 
 #include <QCoreApplication>
+#include <QBuffer>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QImageWriter>
+#include <QSaveFile>
+#include <QtConcurrent/QtConcurrentRun>
 #if defined(QT_OPENGL_ES_2)
 #include <QOpenGLFunctions_ES2>
 #else
 #include <QOpenGLFunctions>
 #endif
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLContext>
 #include <QPointer>
 #include <QSharedPointer>
 #include <QWindow>
 
+#include <EGL/egl.h>
+
+#ifndef MOZGRAB_DEFAULT_FILTER_PASSES
+#define MOZGRAB_DEFAULT_FILTER_PASSES 2
+#endif
+
 // Handle web page grab readiness through event loop so that connection type to the ready signal doesn't matter.
 const QEvent::Type Event_WebPageGrab_Completed = static_cast<QEvent::Type>(QEvent::registerEventType());
 
+namespace {
+
+const GLuint DownscaleVertexAttribute = 0;
+
+const char *const DownscaleVertexShader =
+        "attribute highp vec2 aVertex;                              \n"
+        "uniform highp vec4 sourceRect;                             \n"
+        "varying highp vec2 vTexCoord;                              \n"
+        "void main() {                                              \n"
+        "    gl_Position = vec4(aVertex * 2.0 - 1.0, 0.0, 1.0);     \n"
+        "    vTexCoord = sourceRect.xy + aVertex * sourceRect.zw;   \n"
+        "}";
+
+const char *const DownscaleSampler2D =
+        "#define SAMPLER sampler2D                                  \n";
+
+const char *const DownscaleSamplerExternal =
+        "#extension GL_OES_EGL_image_external : require            \n"
+        "#define SAMPLER samplerExternalOES                         \n";
+
+// Four bilinear taps a quarter of the destination pixel footprint away from
+// its centre. On the 2x passes they land on the centres of the 2x2 block of
+// source texels, which is an exact box filter; on the final pass each tap
+// blends its own 2x2 neighbourhood, a reasonable approximation of one.
+const char *const DownscaleFragmentShader =
+        "uniform lowp SAMPLER texture;                              \n"
+        "uniform highp vec2 footprint;                              \n"
+        "varying highp vec2 vTexCoord;                              \n"
+        "void main() {                                              \n"
+        "    highp vec2 d = footprint * 0.25;                       \n"
+        "    gl_FragColor = 0.25 * (                                \n"
+        "            texture2D(texture, vTexCoord + vec2(-d.x, -d.y)) \n"
+        "          + texture2D(texture, vTexCoord + vec2( d.x, -d.y)) \n"
+        "          + texture2D(texture, vTexCoord + vec2(-d.x,  d.y)) \n"
+        "          + texture2D(texture, vTexCoord + vec2( d.x,  d.y)));\n"
+        "}";
+
+GLuint compileShader(GLenum type, const char *source, const char *prefix = "")
+{
+    const char *const sources[] = { prefix, source };
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 2, sources, nullptr);
+    glCompileShader(shader);
+
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+GLuint createDownscaleProgram(const char *samplerPrefix)
+{
+    const GLuint vertexShader = compileShader(GL_VERTEX_SHADER, DownscaleVertexShader);
+    const GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, DownscaleFragmentShader, samplerPrefix);
+    if (!vertexShader || !fragmentShader) {
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        qCWarning(lcEmbedLiteExt) << "Failed to compile grab downscale shaders";
+        return 0;
+    }
+
+    const GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glBindAttribLocation(program, DownscaleVertexAttribute, "aVertex");
+    glLinkProgram(program);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        glDeleteProgram(program);
+        qCWarning(lcEmbedLiteExt) << "Failed to link grab downscale program";
+        return 0;
+    }
+    return program;
+}
+
+// Downscale programs of one GL context, compiled on first use.
+struct DownscalePrograms {
+    GLuint sampler2D = 0;
+    GLuint samplerExternal = 0;
+
+    GLuint &program(GLenum target)
+    {
+        return target == GL_TEXTURE_2D ? sampler2D : samplerExternal;
+    }
+
+    void release()
+    {
+        glDeleteProgram(sampler2D);
+        glDeleteProgram(samplerExternal);
+        *this = DownscalePrograms();
+    }
+};
+
+QMutex sContextProgramsMutex;
+QHash<QOpenGLContext *, DownscalePrograms> sContextPrograms;
+
+// Programs of the Gecko compositor context, which is not a QOpenGLContext.
+// There is one such context per compositor thread.
+struct NativeDownscalePrograms {
+    EGLContext context = EGL_NO_CONTEXT;
+    DownscalePrograms programs;
+};
+
+thread_local NativeDownscalePrograms sNativePrograms;
+
+/*
+ * Returns the downscale program sampling \a target in the current GL context,
+ * compiling it the first time it is needed in that context. Programs of Qt
+ * contexts are released when the context is destroyed, those of the Gecko
+ * compositor context are dropped along with it.
+ */
+GLuint downscaleProgram(GLenum target)
+{
+    const char *samplerPrefix = target == GL_TEXTURE_2D ? DownscaleSampler2D : DownscaleSamplerExternal;
+
+    if (QOpenGLContext *context = QOpenGLContext::currentContext()) {
+        QMutexLocker lock(&sContextProgramsMutex);
+        if (!sContextPrograms.contains(context)) {
+            QObject::connect(context, &QOpenGLContext::aboutToBeDestroyed, [context]() {
+                DownscalePrograms programs;
+                {
+                    QMutexLocker contextLock(&sContextProgramsMutex);
+                    programs = sContextPrograms.take(context);
+                }
+                // Otherwise they are freed along with the context share group.
+                if (QOpenGLContext::currentContext() == context) {
+                    programs.release();
+                }
+            });
+        }
+        GLuint &program = sContextPrograms[context].program(target);
+        if (!program) {
+            program = createDownscaleProgram(samplerPrefix);
+        }
+        return program;
+    }
+
+    // The names of a previous context are meaningless in this one.
+    const EGLContext context = eglGetCurrentContext();
+    if (sNativePrograms.context != context) {
+        sNativePrograms.context = context;
+        sNativePrograms.programs = DownscalePrograms();
+    }
+    GLuint &program = sNativePrograms.programs.program(target);
+    if (!program || !glIsProgram(program)) {
+        program = createDownscaleProgram(samplerPrefix);
+    }
+    return program;
+}
+
+GLuint createTexture(GLenum format, const QSize &size)
+{
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    // Non power of two textures are only complete with clamping and without mipmaps on ES2.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, size.width(), size.height(), 0, format, GL_UNSIGNED_BYTE, nullptr);
+    return texture;
+}
+
+// Saves the GL state touched by the downscaler and restores it when going
+// out of scope so that the compositor does not notice the extra passes.
+class GLStateSaver
+{
+public:
+    GLStateSaver()
+    {
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+        glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+        glActiveTexture(GL_TEXTURE0);
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+#if defined(QT_OPENGL_ES_2)
+        glGetIntegerv(GL_TEXTURE_BINDING_EXTERNAL_OES, &externalTexture);
+#endif
+        glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &arrayBuffer);
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glGetVertexAttribiv(DownscaleVertexAttribute, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &attributeEnabled);
+        blend = glIsEnabled(GL_BLEND);
+        scissor = glIsEnabled(GL_SCISSOR_TEST);
+        depth = glIsEnabled(GL_DEPTH_TEST);
+        stencil = glIsEnabled(GL_STENCIL_TEST);
+        cull = glIsEnabled(GL_CULL_FACE);
+    }
+
+    ~GLStateSaver()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glUseProgram(program);
+        glBindTexture(GL_TEXTURE_2D, texture);
+#if defined(QT_OPENGL_ES_2)
+        glBindTexture(GL_TEXTURE_EXTERNAL_OES, externalTexture);
+#endif
+        glActiveTexture(activeTexture);
+        glBindBuffer(GL_ARRAY_BUFFER, arrayBuffer);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        if (!attributeEnabled) {
+            glDisableVertexAttribArray(DownscaleVertexAttribute);
+        }
+        restore(GL_BLEND, blend);
+        restore(GL_SCISSOR_TEST, scissor);
+        restore(GL_DEPTH_TEST, depth);
+        restore(GL_STENCIL_TEST, stencil);
+        restore(GL_CULL_FACE, cull);
+    }
+
+private:
+    static void restore(GLenum capability, GLboolean enabled)
+    {
+        if (enabled) {
+            glEnable(capability);
+        } else {
+            glDisable(capability);
+        }
+    }
+
+    GLint framebuffer = 0;
+    GLint program = 0;
+    GLint activeTexture = GL_TEXTURE0;
+    GLint texture = 0;
+    GLint externalTexture = 0;
+    GLint arrayBuffer = 0;
+    GLint viewport[4] = { 0, 0, 0, 0 };
+    GLint attributeEnabled = GL_FALSE;
+    GLboolean blend = GL_FALSE;
+    GLboolean scissor = GL_FALSE;
+    GLboolean depth = GL_FALSE;
+    GLboolean stencil = GL_FALSE;
+    GLboolean cull = GL_FALSE;
+};
+
+bool encodeImage(const QImage &image, QIODevice *device, const QByteArray &format, int quality)
+{
+    QImageWriter writer(device, format);
+    writer.setQuality(quality);
+    if (!writer.write(image)) {
+        qCWarning(lcEmbedLiteExt) << "Failed to encode grab as" << format << writer.errorString();
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
 QImage gl_read_framebuffer(const QRect &rect)
 {
     QSize size = rect.size();
@@ -46,26 +318,256 @@ QImage gl_read_framebuffer(const QRect &rect)
     return QImage();
 }
 
+/*
+ * Renders \a sourceRect of \a texture, which is \a textureSize pixels and bound to
+ * \a target, into successively smaller textures and reads back only the final
+ * \a size pass. At most \a filterPasses intermediate 2x box filter passes are
+ * rendered before the final pass. The caller keeps the ownership of \a texture.
+ *
+ * Returns a null image if the passes could not be rendered.
+ */
+static QImage gl_read_texture_scaled(GLenum target, GLuint texture, const QSize &textureSize,
+                                     const QRect &sourceRect, const QSize &size, int filterPasses)
+{
+    while (glGetError());
+
+    GLStateSaver stateSaver;
+
+    const GLuint firstProgram = downscaleProgram(target);
+    if (!firstProgram) {
+        return QImage();
+    }
+
+    GLuint framebuffer = 0;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    static const GLfloat vertices[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glVertexAttribPointer(DownscaleVertexAttribute, 2, GL_FLOAT, GL_FALSE, 0, vertices);
+    glEnableVertexAttribArray(DownscaleVertexAttribute);
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_STENCIL_TEST);
+    glDisable(GL_CULL_FACE);
+
+    GLenum sourceTarget = target;
+    GLuint sourceTexture = texture;
+    QSize sourceSize = sourceRect.size();
+    QRectF sourceTexCoords(qreal(sourceRect.x()) / textureSize.width(),
+                           qreal(sourceRect.y()) / textureSize.height(),
+                           qreal(sourceRect.width()) / textureSize.width(),
+                           qreal(sourceRect.height()) / textureSize.height());
+
+    bool complete = true;
+    bool lastPass = false;
+    int pass = 0;
+    while (!lastPass) {
+        QSize targetSize = sourceSize / 2;
+        if (pass >= filterPasses || targetSize.width() < size.width() || targetSize.height() < size.height()) {
+            targetSize = size;
+            lastPass = true;
+        }
+
+        GLuint targetTexture = createTexture(GL_RGBA, targetSize);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, targetTexture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            glDeleteTextures(1, &targetTexture);
+            complete = false;
+            break;
+        }
+
+        // Passes after the first always sample our own 2D textures.
+        const GLuint passProgram = pass > 0 ? downscaleProgram(GL_TEXTURE_2D) : firstProgram;
+        if (!passProgram) {
+            glDeleteTextures(1, &targetTexture);
+            complete = false;
+            break;
+        }
+
+        // A pass that does not shrink a dimension samples texel centers directly.
+        const GLfloat footprintX = targetSize.width() < sourceSize.width()
+                ? sourceTexCoords.width() / targetSize.width() : 0.0f;
+        const GLfloat footprintY = targetSize.height() < sourceSize.height()
+                ? sourceTexCoords.height() / targetSize.height() : 0.0f;
+
+        glUseProgram(passProgram);
+        glUniform1i(glGetUniformLocation(passProgram, "texture"), 0);
+        glUniform2f(glGetUniformLocation(passProgram, "footprint"), footprintX, footprintY);
+        glUniform4f(glGetUniformLocation(passProgram, "sourceRect"),
+                    sourceTexCoords.x(), sourceTexCoords.y(),
+                    sourceTexCoords.width(), sourceTexCoords.height());
+        glBindTexture(sourceTarget, sourceTexture);
+        glViewport(0, 0, targetSize.width(), targetSize.height());
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glBindTexture(sourceTarget, 0);
+
+        if (pass > 0) {
+            glDeleteTextures(1, &sourceTexture);
+        }
+        sourceTarget = GL_TEXTURE_2D;
+        sourceTexture = targetTexture;
+        sourceSize = targetSize;
+        sourceTexCoords = QRectF(0, 0, 1, 1);
+        ++pass;
+    }
+
+    QImage image;
+    if (complete) {
+        // Framebuffer still holds the last pass.
+        image = gl_read_framebuffer(QRect(QPoint(0, 0), size));
+    } else {
+        qCWarning(lcEmbedLiteExt) << "Grab downscale framebuffer is incomplete";
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+    if (pass > 0) {
+        glDeleteTextures(1, &sourceTexture);
+    }
+
+    return image;
+}
+
+/*
+ * Copies \a rect of the currently bound framebuffer into a texture, shrinks it on the
+ * GPU to \a size and reads back only the downscaled pixels. At most \a filterPasses
+ * intermediate 2x box filter passes are rendered before the final pass to \a size.
+ *
+ * Returns a null image if the downscale could not be done, in which case the caller
+ * should fall back to reading the full rect.
+ */
+static QImage gl_read_framebuffer_scaled(const QRect &rect, const QSize &size, int filterPasses)
+{
+    GLStateSaver stateSaver;
+
+    // Copy the source rect on the GPU. The framebuffer may lack an alpha channel
+    // so the copy must not ask for one.
+    GLuint sourceTexture = createTexture(GL_RGB, rect.size());
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, rect.x(), rect.y(), rect.width(), rect.height());
+
+    QImage image = gl_read_texture_scaled(GL_TEXTURE_2D, sourceTexture, rect.size(),
+                                          QRect(QPoint(0, 0), rect.size()), size, filterPasses);
+    glDeleteTextures(1, &sourceTexture);
+    return image;
+}
+
 class QMozGrabResultPrivate
 {
 public:
     QMozGrabResultPrivate(QMozGrabResult *q)
         : q_ptr(q)
+        , filterPasses(MOZGRAB_DEFAULT_FILTER_PASSES)
+        , scaled(true)
         , ready(false)
     {
     }
 
     static QMozGrabResult *create(QMozOpenGLWebPage *webPage, const QSize &targetSize);
 
+    static QMozGrabResult *create(QMozOpenGLWebPage *webPage, const QSize &targetSize,
+                                  const QSize &sourceSize, int filterPasses);
+
+    static QMozGrabResult *create(QMozWindow *mozWindow, const QSize &targetSize,
+                                  const QSize &sourceSize, int filterPasses);
+
+    void grabGeometry(const QSize &available, QRect *sourceRect, QSize *target) const;
+    QImage rotated(QImage image) const;
+
     QMozGrabResult *q_ptr;
     QPointer<QMozOpenGLWebPage> webPage;
     QSize textureSize;
+    QSize sourceSize;
+    int filterPasses;
+    bool scaled;
     QImage image;
     Qt::ScreenOrientation orientation;
     Qt::ScreenOrientation primaryOrientation;
     bool ready;
 };
 
+void QMozGrabResultPrivate::grabGeometry(const QSize &available, QRect *sourceRect, QSize *target) const
+{
+    QSize targetSize = textureSize;
+    QSize areaSize = sourceSize.isEmpty() ? targetSize : sourceSize;
+
+    if (primaryOrientation == Qt::PortraitOrientation
+            && (orientation == Qt::LandscapeOrientation || orientation == Qt::InvertedLandscapeOrientation)) {
+        targetSize.transpose();
+        areaSize.transpose();
+    }
+
+    if (scaled && sourceSize.isEmpty()) {
+        // Scaled grabs default to the whole framebuffer.
+        areaSize = available;
+    }
+
+    if (areaSize.width() > available.width() || areaSize.height() > available.height()) {
+        // If the requested size is too large, shrink it to fit while retaining the aspect ratio.
+        areaSize = areaSize.scaled(available, Qt::KeepAspectRatio);
+    }
+
+    if (scaled) {
+        // Fit the grabbed area into the target while retaining its aspect ratio.
+        targetSize = areaSize.scaled(targetSize, Qt::KeepAspectRatio);
+    }
+
+    if (targetSize.width() > areaSize.width() || targetSize.height() > areaSize.height()) {
+        // Never upscale, the caller can do that cheaper from the smaller image.
+        targetSize = areaSize;
+    }
+
+    int w = areaSize.width();
+    int h = areaSize.height();
+    int x = orientation == Qt::LandscapeOrientation ? available.width() - w : 0;
+    int y = (orientation == Qt::PortraitOrientation
+             || orientation == Qt::LandscapeOrientation) ? available.height() - h : 0;
+
+    *sourceRect = QRect(x, y, w, h);
+    *target = targetSize;
+}
+
+QImage QMozGrabResultPrivate::rotated(QImage image) const
+{
+    if (primaryOrientation == Qt::PortraitOrientation) {
+        if (orientation != Qt::PortraitOrientation && orientation != Qt::PrimaryOrientation) {
+            QMatrix rotationMatrix;
+            switch (orientation) {
+            case Qt::LandscapeOrientation:
+                rotationMatrix.rotate(270);
+                break;
+            case Qt::InvertedLandscapeOrientation:
+                rotationMatrix.rotate(90);
+                break;
+            case Qt::InvertedPortraitOrientation:
+                rotationMatrix.rotate(180);
+            default:
+                break;
+            }
+            image = image.transformed(rotationMatrix);
+        }
+    } else if (orientation != Qt::LandscapeOrientation && orientation != Qt::PrimaryOrientation) {
+        QMatrix rotationMatrix;
+        switch (orientation) {
+        case Qt::PortraitOrientation:
+            rotationMatrix.rotate(90);
+            break;
+        case Qt::InvertedLandscapeOrientation:
+            rotationMatrix.rotate(180);
+            break;
+        case Qt::InvertedPortraitOrientation:
+            rotationMatrix.rotate(270);
+        default:
+            break;
+        }
+        image = image.transformed(rotationMatrix);
+    }
+
+    return image;
+}
+
 QMozGrabResult::~QMozGrabResult()
 {
     delete d_ptr;
@@ -96,6 +598,70 @@ bool QMozGrabResult::saveToFile(const QString &fileName)
     return d->image.save(fileName);
 }
 
+/*!
+ * Encodes the grabbed image on a worker thread and writes it to \a fileName.
+ *
+ * The file is written atomically so readers never see a partial image. The
+ * \a format defaults to the suffix of \a fileName. The meaning of \a quality
+ * depends on the format: for JPEG and WebP it trades size for fidelity, for PNG
+ * it trades size for speed with 100 writing uncompressed data. WebP requires the
+ * Qt image formats plugin.
+ *
+ * The signal saved() is emitted once done.
+ */
+void QMozGrabResult::saveToFileAsync(const QString &fileName, const QString &format, int quality)
+{
+    Q_D(QMozGrabResult);
+    const QImage image = d->image;
+    const QByteArray imageFormat = format.isEmpty() ? QFileInfo(fileName).suffix().toLatin1() : format.toLatin1();
+
+    QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, fileName]() {
+        Q_EMIT saved(fileName, watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run([image, fileName, imageFormat, quality]() {
+        QSaveFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly)) {
+            qCWarning(lcEmbedLiteExt) << "Failed to open" << fileName << file.errorString();
+            return false;
+        }
+        if (!encodeImage(image, &file, imageFormat, quality)) {
+            file.cancelWriting();
+            return false;
+        }
+        return file.commit();
+    }));
+}
+
+/*!
+ * Encodes the grabbed image on a worker thread into memory, for example for uploading.
+ *
+ * The \a format and \a quality are as for saveToFileAsync(). The signal encoded()
+ * is emitted once done, with empty data if encoding failed.
+ */
+void QMozGrabResult::encodeAsync(const QString &format, int quality)
+{
+    Q_D(QMozGrabResult);
+    const QImage image = d->image;
+    const QByteArray imageFormat = format.toLatin1();
+
+    QFutureWatcher<QByteArray> *watcher = new QFutureWatcher<QByteArray>(this);
+    connect(watcher, &QFutureWatcher<QByteArray>::finished, this, [this, watcher]() {
+        Q_EMIT encoded(watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run([image, imageFormat, quality]() {
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        if (!encodeImage(image, &buffer, imageFormat, quality)) {
+            return QByteArray();
+        }
+        return data;
+    }));
+}
+
 bool QMozGrabResult::event(QEvent *e)
 {
     Q_D(QMozGrabResult);
@@ -110,64 +676,47 @@ bool QMozGrabResult::event(QEvent *e)
 void QMozGrabResult::captureImage(const QRect &rect)
 {
     Q_D(QMozGrabResult);
-    int w = d->textureSize.width();
-    int h = d->textureSize.height();
+    QRect sourceRect;
+    QSize targetSize;
+    d->grabGeometry(rect.size(), &sourceRect, &targetSize);
 
-    if (d->primaryOrientation == Qt::PortraitOrientation
-            && (d->orientation == Qt::LandscapeOrientation || d->orientation == Qt::InvertedLandscapeOrientation)) {
-        qSwap<int>(w, h);
+    QImage image;
+    if (targetSize != sourceRect.size() && !targetSize.isEmpty()) {
+        image = gl_read_framebuffer_scaled(sourceRect, targetSize, d->filterPasses);
+        if (image.isNull()) {
+            image = gl_read_framebuffer(sourceRect).scaled(targetSize, Qt::IgnoreAspectRatio,
+                                                           Qt::SmoothTransformation);
+        }
+    } else {
+        image = gl_read_framebuffer(sourceRect);
     }
 
-    if (w > rect.width() || h > rect.height()) {
-        // If the requested size is too large, shrink it to fit while retaining the aspect ratio.
-        QSize size = QSize(w, h).scaled(rect.size(), Qt::KeepAspectRatio);
-        w = size.width();
-        h = size.height();
-    }
+    d->image = d->rotated(image);
+    QCoreApplication::postEvent(this, new QEvent(Event_WebPageGrab_Completed));
+}
 
-    int x = d->orientation == Qt::LandscapeOrientation ? rect.width() - w : 0;
-    int y = (d->orientation == Qt::PortraitOrientation
-             || d->orientation == Qt::LandscapeOrientation) ? rect.height() - h : 0;
+#if defined(QT_OPENGL_ES_2)
+void QMozGrabResult::captureTexture(uint textureId, const QSize &textureSize)
+{
+    Q_D(QMozGrabResult);
+    QRect sourceRect;
+    QSize targetSize;
+    d->grabGeometry(textureSize, &sourceRect, &targetSize);
+    if (targetSize.isEmpty()) {
+        targetSize = sourceRect.size();
+    }
 
-    QRect targetRect(x, y, w, h);
-    QImage image = gl_read_framebuffer(targetRect);
-    if (d->primaryOrientation == Qt::PortraitOrientation) {
-        if (d->orientation != Qt::PortraitOrientation && d->orientation != Qt::PrimaryOrientation) {
-            QMatrix rotationMatrix;
-            switch (d->orientation) {
-            case Qt::LandscapeOrientation:
-                rotationMatrix.rotate(270);
-                break;
-            case Qt::InvertedLandscapeOrientation:
-                rotationMatrix.rotate(90);
-                break;
-            case Qt::InvertedPortraitOrientation:
-                rotationMatrix.rotate(180);
-            default:
-                break;
-            }
-            image = image.transformed(rotationMatrix);
-        }
-    } else if (d->orientation != Qt::LandscapeOrientation && d->orientation != Qt::PrimaryOrientation) {
-        QMatrix rotationMatrix;
-        switch (d->orientation) {
-        case Qt::PortraitOrientation:
-            rotationMatrix.rotate(90);
-            break;
-        case Qt::InvertedLandscapeOrientation:
-            rotationMatrix.rotate(180);
-            break;
-        case Qt::InvertedPortraitOrientation:
-            rotationMatrix.rotate(270);
-        default:
-            break;
-        }
-        image = image.transformed(rotationMatrix);
+    // External textures cannot be read directly, so even unscaled grabs take one render pass.
+    QImage image = gl_read_texture_scaled(GL_TEXTURE_EXTERNAL_OES, textureId, textureSize,
+                                          sourceRect, targetSize, d->filterPasses);
+    if (image.isNull()) {
+        qCWarning(lcEmbedLiteExt) << "Failed to grab view texture";
     }
 
-    d->image = image;
+    d->image = d->rotated(image);
     QCoreApplication::postEvent(this, new QEvent(Event_WebPageGrab_Completed));
 }
+#endif
 
 QMozGrabResult::QMozGrabResult(QObject *parent)
     : QObject(parent)
@@ -176,6 +725,16 @@ QMozGrabResult::QMozGrabResult(QObject *parent)
 }
 
 QMozGrabResult *QMozGrabResultPrivate::create(QMozOpenGLWebPage *webPage, const QSize &targetSize)
+{
+    QMozGrabResult *result = create(webPage, targetSize, QSize(), MOZGRAB_DEFAULT_FILTER_PASSES);
+    if (result) {
+        result->d_func()->scaled = false;
+    }
+    return result;
+}
+
+QMozGrabResult *QMozGrabResultPrivate::create(QMozOpenGLWebPage *webPage, const QSize &targetSize,
+                                              const QSize &sourceSize, int filterPasses)
 {
     Q_ASSERT(webPage);
 
@@ -207,6 +766,8 @@ QMozGrabResult *QMozGrabResultPrivate::create(QMozOpenGLWebPage *webPage, const
     QMozGrabResult *result = new QMozGrabResult();
     QMozGrabResultPrivate *d = result->d_func();
     d->textureSize = size;
+    d->sourceSize = sourceSize;
+    d->filterPasses = filterPasses < 0 ? MOZGRAB_DEFAULT_FILTER_PASSES : filterPasses;
     d->webPage = webPage;
     d->orientation = webPage->mozWindow()->contentOrientation();
     d->primaryOrientation = webPage->mozWindow()->primaryOrientation();
@@ -214,6 +775,22 @@ QMozGrabResult *QMozGrabResultPrivate::create(QMozOpenGLWebPage *webPage, const
     return result;
 }
 
+QMozGrabResult *QMozGrabResultPrivate::create(QMozWindow *mozWindow, const QSize &targetSize,
+                                              const QSize &sourceSize, int filterPasses)
+{
+    Q_ASSERT(mozWindow);
+
+    QMozGrabResult *result = new QMozGrabResult();
+    QMozGrabResultPrivate *d = result->d_func();
+    d->textureSize = targetSize;
+    d->sourceSize = sourceSize;
+    d->filterPasses = filterPasses < 0 ? MOZGRAB_DEFAULT_FILTER_PASSES : filterPasses;
+    d->orientation = mozWindow->contentOrientation();
+    d->primaryOrientation = mozWindow->primaryOrientation();
+
+    return result;
+}
+
 /*!
  * Grabs the web page into an in-memory image.
  *
@@ -237,3 +814,71 @@ QSharedPointer<QMozGrabResult> QMozOpenGLWebPage::grabToImage(const QSize &targe
     return result;
 }
 
+/*!
+ * Grabs the \a sourceSize area of the web page and scales it down to \a targetSize.
+ *
+ * An empty \a sourceSize grabs the whole web page. Downscaling is done on the GPU
+ * before the pixels are read back so only \a targetSize pixels are copied into
+ * CPU's memory. Up to \a filterPasses intermediate 2x box filter passes are used
+ * to improve the quality of large reductions; zero does a single filtered pass
+ * and a negative value uses the default of MOZGRAB_DEFAULT_FILTER_PASSES.
+ *
+ * As with the other overload the signal QMozGrabResult::ready() is emitted when
+ * the grab has been completed.
+ */
+QSharedPointer<QMozGrabResult> QMozOpenGLWebPage::grabToImage(const QSize &targetSize, const QSize &sourceSize,
+                                                              int filterPasses)
+{
+    if (targetSize.isEmpty()) {
+        qWarning() << "OpenGLWebPage::grabToImage scaled grab requires a target size";
+        return QSharedPointer<QMozGrabResult>();
+    }
+
+    QSharedPointer<QMozGrabResult> result(QMozGrabResultPrivate::create(this, targetSize, sourceSize, filterPasses));
+    if (result) {
+        QMutexLocker lock(&mGrabResultListLock);
+        mGrabResultList.append(result.toWeakRef());
+        update();
+    }
+    return result;
+}
+
+/*!
+ * Grabs the content of the view into an in-memory image.
+ *
+ * Unlike QQuickItem::grabToImage() this does not render the scene again but reads
+ * the latest composited frame directly from the view texture on the render thread.
+ * The grab happens asynchronously and the signal QMozGrabResult::ready() is emitted
+ * when the grab has been completed.
+ *
+ * The \a targetSize and \a sourceSize behave as for QMozOpenGLWebPage::grabToImage(),
+ * empty sizes grab the whole view at its native size.
+ */
+QSharedPointer<QMozGrabResult> QuickMozView::grabContentToImage(const QSize &targetSize, const QSize &sourceSize,
+                                                                int filterPasses)
+{
+#if defined(QT_OPENGL_ES_2)
+    if (!d->mMozWindow) {
+        qWarning() << "QuickMozView::grabContentToImage view is not attached to a window";
+        return QSharedPointer<QMozGrabResult>();
+    }
+
+    if (!d->mViewInitialized || !d->mActive) {
+        qWarning() << "QuickMozView::grabContentToImage only initialized and active views can be grabbed";
+        return QSharedPointer<QMozGrabResult>();
+    }
+
+    QSharedPointer<QMozGrabResult> result(QMozGrabResultPrivate::create(d->mMozWindow, targetSize, sourceSize,
+                                                                        filterPasses));
+    QMutexLocker lock(&mGrabResultListLock);
+    mGrabResultList.append(result.toWeakRef());
+    update();
+    return result;
+#else
+    Q_UNUSED(targetSize);
+    Q_UNUSED(sourceSize);
+    Q_UNUSED(filterPasses);
+    qWarning() << "QuickMozView::grabContentToImage is only implemented for OpenGL ES 2";
+    return QSharedPointer<QMozGrabResult>();
+#endif
+}
@@ -26,18 +26,24 @@ public:
     bool isReady() const;
 
     Q_INVOKABLE bool saveToFile(const QString &fileName);
+    Q_INVOKABLE void saveToFileAsync(const QString &fileName, const QString &format = QString(), int quality = -1);
+    Q_INVOKABLE void encodeAsync(const QString &format = QStringLiteral("PNG"), int quality = -1);
 
 protected:
     bool event(QEvent *e);
 
 Q_SIGNALS:
     void ready();
+    void saved(const QString &fileName, bool success);
+    void encoded(const QByteArray &data);
 
 private:
     friend class QMozOpenGLWebPage;
+    friend class QuickMozView;
 
     QMozGrabResult(QObject *parent = 0);
     void captureImage(const QRect &rect);
+    void captureTexture(uint textureId, const QSize &textureSize);
 
     QMozGrabResultPrivate *d_ptr;
 
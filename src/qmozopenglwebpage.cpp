@@ -19,6 +19,7 @@
 #include "qmozembedlog.h"
 #include "qmozgrabresult.h"
 #include "qmozscrolldecorator.h"
+#include "qmozthumbnailcache_p.h"
 #include "qmozwindow.h"
 #include "qmozwindow_p.h"
 
@@ -66,6 +67,7 @@ QMozOpenGLWebPage::QMozOpenGLWebPage(QObject *parent)
 QMozOpenGLWebPage::~QMozOpenGLWebPage()
 {
     if (d->mView) {
+        QMozThumbnailCachePrivate::viewDestroyed(d->mView->GetUniqueID());
         d->mView->SetIsActive(false);
         d->mView->SetListener(nullptr);
         d->mContext->GetApp()->DestroyView(d->mView);
@@ -102,6 +104,9 @@ void QMozOpenGLWebPage::onDrawOverlay(const QRect &rect)
         }
         mGrabResultList.clear();
     }
+    if (d->mView) {
+        QMozThumbnailCachePrivate::notifyPainted(d->mView->GetUniqueID());
+    }
     Q_EMIT afterRendering();
 }
 
@@ -158,6 +163,7 @@ void QMozOpenGLWebPage::setActive(bool active)
     if (d->mActive != active) {
         d->mActive = active;
         d->mView->SetIsActive(d->mActive);
+        d->activeStateChanged();
         Q_EMIT activeChanged();
     }
 }
@@ -562,6 +568,30 @@ void QMozOpenGLWebPage::runJavaScript(const QString &script,
     d->runJavaScript(script, callback, errorCallback);
 }
 
+/*
+ * Runs \a script and passes its result or error to \a callback without
+ * going through a QML engine. Thread-safe, \a callback is called on the
+ * thread of the view.
+ */
+void QMozOpenGLWebPage::runJavaScript(const QString &script, const QMozJavaScriptCallback &callback)
+{
+    d->runJavaScript(script, callback);
+}
+
+/*
+ * Completes a sync message whose reply was deferred with
+ * QMozReturnValue::defer(). Thread-safe.
+ */
+void QMozOpenGLWebPage::replySyncMessage(uint token, const QVariant &message)
+{
+    d->replySyncMessage(token, message);
+}
+
+QMozViewDiagnostics *QMozOpenGLWebPage::diagnostics()
+{
+    return d->diagnostics();
+}
+
 // This should be a const method returning a pointer to a const object
 // but unfortunately this conflicts with it being exposed as a Q_PROPERTY
 QMozSecurity *QMozOpenGLWebPage::security()
@@ -632,7 +662,7 @@ void QMozOpenGLWebPage::suspendView()
         return;
     }
     setActive(false);
-    d->mView->SuspendTimeouts();
+    d->setTimeoutsSuspended(true);
 }
 
 void QMozOpenGLWebPage::resumeView()
@@ -640,16 +670,11 @@ void QMozOpenGLWebPage::resumeView()
     if (!d || !d->mViewInitialized) {
         return;
     }
+    // Setting view as active resets RefreshDriver()->SetThrottled at
+    // PresShell::SetIsActive (nsPresShell), QMozViewPrivate::activeStateChanged
+    // re-applies painting throttling.
     setActive(true);
-
-    // Setting view as active, will reset RefreshDriver()->SetThrottled at
-    // PresShell::SetIsActive (nsPresShell). Thus, keep on throttling
-    // if should keep on throttling.
-    if (mThrottlePainting) {
-        d->setThrottlePainting(true);
-    }
-
-    d->mView->ResumeTimeouts();
+    d->setTimeoutsSuspended(false);
 }
 
 /*!
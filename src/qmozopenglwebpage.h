@@ -28,6 +28,7 @@ class QMozViewPrivate;
 class QMozGrabResult;
 class QMozWindow;
 class QMozSecurity;
+class QMozViewDiagnostics;
 
 class QMozOpenGLWebPage : public QObject
 {
@@ -80,6 +81,8 @@ public:
     void timerEvent(QTimerEvent *);
 
     QSharedPointer<QMozGrabResult> grabToImage(const QSize &targetSize = QSize());
+    QSharedPointer<QMozGrabResult> grabToImage(const QSize &targetSize, const QSize &sourceSize,
+                                               int filterPasses = -1);
 
 public Q_SLOTS:
     Q_MOZ_VIEW_PUBLIC_SLOTS
@@ -0,0 +1,564 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "qmozthumbnailcache.h"
+#include "qmozthumbnailcache_p.h"
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "qmozembedlog.h"
+#include "qmozgrabresult.h"
+#include "qmozopenglwebpage.h"
+#include "quickmozview.h"
+
+// Byte budget shared by all cached thumbnails.
+#ifndef MOZTHUMBNAIL_DEFAULT_BUDGET
+#define MOZTHUMBNAIL_DEFAULT_BUDGET (8 * 1024 * 1024)
+#endif
+
+// Number of most recently used thumbnails kept decoded.
+#ifndef MOZTHUMBNAIL_HOT_ENTRIES
+#define MOZTHUMBNAIL_HOT_ENTRIES 4
+#endif
+
+#ifndef MOZTHUMBNAIL_COMPRESS_DELAY
+#define MOZTHUMBNAIL_COMPRESS_DELAY 1000
+#endif
+
+#ifndef MOZTHUMBNAIL_COMPRESS_QUALITY
+#define MOZTHUMBNAIL_COMPRESS_QUALITY 85
+#endif
+
+#define MOZTHUMBNAIL_COMPRESS_FORMAT "JPG"
+
+Q_GLOBAL_STATIC(QMozThumbnailCache, thumbnailCacheInstance)
+Q_GLOBAL_STATIC(QMozThumbnailCachePrivate, thumbnailCachePrivateInstance)
+
+namespace {
+
+class ThumbnailCompressor : public QRunnable
+{
+public:
+    ThumbnailCompressor(QMozThumbnailCachePrivate *cache, quint32 uniqueId, int revision, const QImage &image)
+        : mCache(cache)
+        , mUniqueId(uniqueId)
+        , mRevision(revision)
+        , mImage(image)
+    {
+    }
+
+    void run() override
+    {
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        if (!mImage.save(&buffer, MOZTHUMBNAIL_COMPRESS_FORMAT, MOZTHUMBNAIL_COMPRESS_QUALITY)) {
+            qCWarning(lcEmbedLiteExt) << "Failed to compress thumbnail" << mUniqueId;
+            data.clear();
+        }
+        // Also called on failure so that the entry is no longer marked in flight.
+        mCache->storeCompressed(mUniqueId, mRevision, data);
+    }
+
+private:
+    QMozThumbnailCachePrivate *mCache;
+    quint32 mUniqueId;
+    int mRevision;
+    QImage mImage;
+};
+
+}
+
+QMozThumbnailCachePrivate *QMozThumbnailCachePrivate::instance()
+{
+    return thumbnailCachePrivateInstance();
+}
+
+void QMozThumbnailCachePrivate::notifyPainted(quint32 uniqueId)
+{
+    if (!thumbnailCachePrivateInstance.exists()) {
+        return;
+    }
+
+    QMozThumbnailCachePrivate *cache = thumbnailCachePrivateInstance();
+    QMutexLocker lock(&cache->mMutex);
+    ++cache->mPaintSerials[uniqueId];
+}
+
+void QMozThumbnailCachePrivate::viewDestroyed(quint32 uniqueId)
+{
+    if (!thumbnailCachePrivateInstance.exists()) {
+        return;
+    }
+
+    thumbnailCachePrivateInstance()->remove(uniqueId);
+}
+
+QImage QMozThumbnailCachePrivate::take(quint32 uniqueId)
+{
+    if (!thumbnailCachePrivateInstance.exists()) {
+        return QImage();
+    }
+
+    QMozThumbnailCachePrivate *cache = thumbnailCachePrivateInstance();
+    QImage image = cache->thumbnail(uniqueId);
+    cache->remove(uniqueId);
+    return image;
+}
+
+QMozThumbnailCachePrivate::QMozThumbnailCachePrivate(QObject *parent)
+    : QObject(parent)
+    , mBudget(MOZTHUMBNAIL_DEFAULT_BUDGET)
+    , mCost(0)
+    , mNextRevision(0)
+    , mCompressionScheduled(false)
+{
+    // The first user may be the image provider on a QML loader thread. Timers
+    // and queued calls of the cache must run on the GUI thread regardless.
+    if (QCoreApplication::instance()) {
+        moveToThread(QCoreApplication::instance()->thread());
+    }
+}
+
+QMozThumbnailCachePrivate::~QMozThumbnailCachePrivate()
+{
+}
+
+int QMozThumbnailCachePrivate::budget() const
+{
+    QMutexLocker lock(&mMutex);
+    return mBudget;
+}
+
+void QMozThumbnailCachePrivate::setBudget(int bytes)
+{
+    bytes = qMax(0, bytes);
+    bool evicted;
+    {
+        QMutexLocker lock(&mMutex);
+        if (mBudget == bytes) {
+            return;
+        }
+        mBudget = bytes;
+        const int cost = mCost;
+        evict();
+        evicted = cost != mCost;
+    }
+
+    Q_EMIT budgetChanged();
+    if (evicted) {
+        Q_EMIT costChanged();
+    }
+}
+
+int QMozThumbnailCachePrivate::cost() const
+{
+    QMutexLocker lock(&mMutex);
+    return mCost;
+}
+
+void QMozThumbnailCachePrivate::insert(quint32 uniqueId, const QImage &image)
+{
+    quint64 paintSerial;
+    {
+        QMutexLocker lock(&mMutex);
+        paintSerial = mPaintSerials.value(uniqueId);
+    }
+    insert(uniqueId, image, paintSerial);
+}
+
+void QMozThumbnailCachePrivate::insert(quint32 uniqueId, const QImage &image, quint64 paintSerial)
+{
+    if (image.isNull()) {
+        remove(uniqueId);
+        return;
+    }
+
+    {
+        QMutexLocker lock(&mMutex);
+        Entry &entry = mEntries[uniqueId];
+        entry.image = image;
+        entry.compressed.clear();
+        entry.revision = ++mNextRevision;
+        entry.paintSerial = paintSerial;
+        setCost(entry, image.byteCount());
+        touch(uniqueId);
+        evict();
+    }
+
+    scheduleCompression();
+    Q_EMIT costChanged();
+    Q_EMIT thumbnailChanged(uniqueId);
+}
+
+QImage QMozThumbnailCachePrivate::thumbnail(quint32 uniqueId)
+{
+    QImage image;
+    bool decompressed = false;
+    {
+        QMutexLocker lock(&mMutex);
+        QHash<quint32, Entry>::iterator it = mEntries.find(uniqueId);
+        if (it == mEntries.end()) {
+            return QImage();
+        }
+
+        Entry &entry = it.value();
+        if (entry.image.isNull()) {
+            entry.image = QImage::fromData(entry.compressed, MOZTHUMBNAIL_COMPRESS_FORMAT);
+            if (entry.image.isNull()) {
+                qCWarning(lcEmbedLiteExt) << "Failed to decompress thumbnail" << uniqueId;
+                return QImage();
+            }
+            entry.compressed.clear();
+            setCost(entry, entry.image.byteCount());
+            decompressed = true;
+        }
+        image = entry.image;
+        touch(uniqueId);
+        if (decompressed) {
+            evict();
+        }
+    }
+
+    if (decompressed) {
+        // The image provider may run on a loader thread.
+        QMetaObject::invokeMethod(this, "compressColdEntries", Qt::QueuedConnection);
+        QMetaObject::invokeMethod(this, "costChanged", Qt::QueuedConnection);
+    }
+    return image;
+}
+
+bool QMozThumbnailCachePrivate::contains(quint32 uniqueId) const
+{
+    QMutexLocker lock(&mMutex);
+    return mEntries.contains(uniqueId);
+}
+
+bool QMozThumbnailCachePrivate::needsUpdate(quint32 uniqueId) const
+{
+    QMutexLocker lock(&mMutex);
+    QHash<quint32, Entry>::const_iterator it = mEntries.constFind(uniqueId);
+    if (it == mEntries.constEnd()) {
+        return true;
+    }
+    return it->paintSerial != mPaintSerials.value(uniqueId);
+}
+
+int QMozThumbnailCachePrivate::revision(quint32 uniqueId) const
+{
+    QMutexLocker lock(&mMutex);
+    return mEntries.value(uniqueId).revision;
+}
+
+void QMozThumbnailCachePrivate::remove(quint32 uniqueId)
+{
+    bool removed;
+    {
+        QMutexLocker lock(&mMutex);
+        QHash<quint32, Entry>::iterator it = mEntries.find(uniqueId);
+        removed = it != mEntries.end();
+        if (removed) {
+            mCost -= it->cost;
+            mEntries.erase(it);
+            mRecentlyUsed.removeOne(uniqueId);
+        }
+        mPaintSerials.remove(uniqueId);
+        mPendingGrabs.remove(uniqueId);
+    }
+
+    if (removed) {
+        QMetaObject::invokeMethod(this, "costChanged", Qt::QueuedConnection);
+    }
+}
+
+void QMozThumbnailCachePrivate::clear()
+{
+    {
+        QMutexLocker lock(&mMutex);
+        if (mEntries.isEmpty()) {
+            return;
+        }
+        mEntries.clear();
+        mRecentlyUsed.clear();
+        mPendingGrabs.clear();
+        mCost = 0;
+    }
+    Q_EMIT costChanged();
+}
+
+void QMozThumbnailCachePrivate::trackGrab(quint32 uniqueId, const QSharedPointer<QMozGrabResult> &result)
+{
+    // Snapshot the serial now so that paints racing with the grab
+    // keep the thumbnail marked stale.
+    quint64 serial;
+    {
+        QMutexLocker lock(&mMutex);
+        mPendingGrabs.insert(uniqueId, result);
+        serial = mPaintSerials.value(uniqueId);
+    }
+
+    QWeakPointer<QMozGrabResult> weakResult = result;
+    connect(result.data(), &QMozGrabResult::ready, this, [this, uniqueId, serial, weakResult]() {
+        QSharedPointer<QMozGrabResult> result = weakResult.toStrongRef();
+        {
+            QMutexLocker lock(&mMutex);
+            if (!result || mPendingGrabs.value(uniqueId) != result) {
+                return;
+            }
+            mPendingGrabs.remove(uniqueId);
+        }
+
+        QImage image = result->image();
+        if (!image.isNull()) {
+            insert(uniqueId, image, serial);
+        }
+    });
+}
+
+void QMozThumbnailCachePrivate::storeCompressed(quint32 uniqueId, int revision, const QByteArray &data)
+{
+    {
+        QMutexLocker lock(&mMutex);
+        QHash<quint32, Entry>::iterator it = mEntries.find(uniqueId);
+        if (it == mEntries.end() || it->revision != revision) {
+            return;
+        }
+        it->compressingRevision = 0;
+        if (data.isEmpty() || it->image.isNull()) {
+            return;
+        }
+        // Accessed while compressing, keep it decoded.
+        if (mRecentlyUsed.indexOf(uniqueId) < MOZTHUMBNAIL_HOT_ENTRIES) {
+            return;
+        }
+
+        it->image = QImage();
+        it->compressed = data;
+        setCost(*it, data.size());
+    }
+
+    QMetaObject::invokeMethod(this, "costChanged", Qt::QueuedConnection);
+}
+
+void QMozThumbnailCachePrivate::compressColdEntries()
+{
+    QMutexLocker lock(&mMutex);
+    mCompressionScheduled = false;
+
+    for (int i = MOZTHUMBNAIL_HOT_ENTRIES; i < mRecentlyUsed.count(); ++i) {
+        const quint32 uniqueId = mRecentlyUsed.at(i);
+        Entry &entry = mEntries[uniqueId];
+        // Skip entries whose current image is already being compressed.
+        if (!entry.image.isNull() && entry.compressingRevision != entry.revision) {
+            entry.compressingRevision = entry.revision;
+            QThreadPool::globalInstance()->start(new ThumbnailCompressor(this, uniqueId, entry.revision, entry.image));
+        }
+    }
+}
+
+void QMozThumbnailCachePrivate::touch(quint32 uniqueId)
+{
+    mRecentlyUsed.removeOne(uniqueId);
+    mRecentlyUsed.prepend(uniqueId);
+}
+
+void QMozThumbnailCachePrivate::setCost(Entry &entry, int cost)
+{
+    mCost += cost - entry.cost;
+    entry.cost = cost;
+}
+
+void QMozThumbnailCachePrivate::evict()
+{
+    // Always keep the most recent thumbnail even if it alone exceeds the budget.
+    while (mCost > mBudget && mRecentlyUsed.count() > 1) {
+        const quint32 uniqueId = mRecentlyUsed.takeLast();
+        mCost -= mEntries.take(uniqueId).cost;
+    }
+}
+
+void QMozThumbnailCachePrivate::scheduleCompression()
+{
+    if (mCompressionScheduled) {
+        return;
+    }
+    mCompressionScheduled = true;
+    QTimer::singleShot(MOZTHUMBNAIL_COMPRESS_DELAY, this, SLOT(compressColdEntries()));
+}
+
+QMozThumbnailCache *QMozThumbnailCache::instance()
+{
+    return thumbnailCacheInstance();
+}
+
+QMozThumbnailCache::QMozThumbnailCache(QObject *parent)
+    : QObject(parent)
+    , d_ptr(QMozThumbnailCachePrivate::instance())
+{
+    Q_D(QMozThumbnailCache);
+    connect(d, &QMozThumbnailCachePrivate::budgetChanged, this, &QMozThumbnailCache::budgetChanged);
+    connect(d, &QMozThumbnailCachePrivate::costChanged, this, &QMozThumbnailCache::costChanged);
+    connect(d, &QMozThumbnailCachePrivate::thumbnailChanged, this, &QMozThumbnailCache::thumbnailChanged);
+}
+
+QMozThumbnailCache::~QMozThumbnailCache()
+{
+    // Private is a global static, owned by Q_GLOBAL_STATIC.
+    d_ptr = nullptr;
+}
+
+int QMozThumbnailCache::budget() const
+{
+    Q_D(const QMozThumbnailCache);
+    return d->budget();
+}
+
+void QMozThumbnailCache::setBudget(int bytes)
+{
+    Q_D(QMozThumbnailCache);
+    d->setBudget(bytes);
+}
+
+int QMozThumbnailCache::cost() const
+{
+    Q_D(const QMozThumbnailCache);
+    return d->cost();
+}
+
+void QMozThumbnailCache::insert(quint32 uniqueId, const QImage &image)
+{
+    Q_D(QMozThumbnailCache);
+    d->insert(uniqueId, image);
+}
+
+QImage QMozThumbnailCache::thumbnail(quint32 uniqueId)
+{
+    Q_D(QMozThumbnailCache);
+    return d->thumbnail(uniqueId);
+}
+
+bool QMozThumbnailCache::contains(quint32 uniqueId) const
+{
+    Q_D(const QMozThumbnailCache);
+    return d->contains(uniqueId);
+}
+
+bool QMozThumbnailCache::needsUpdate(quint32 uniqueId) const
+{
+    Q_D(const QMozThumbnailCache);
+    return d->needsUpdate(uniqueId);
+}
+
+/*!
+    \fn QUrl QMozThumbnailCache::url(quint32 uniqueId) const
+
+    Returns the image provider url of the thumbnail of the view \a uniqueId.
+    The url changes whenever the thumbnail is replaced so that Image elements
+    bound to it reload. Returns an empty url if no thumbnail is cached.
+*/
+QUrl QMozThumbnailCache::url(quint32 uniqueId) const
+{
+    Q_D(const QMozThumbnailCache);
+    const int revision = d->revision(uniqueId);
+    if (revision == 0) {
+        return QUrl();
+    }
+    return QUrl(QStringLiteral("image://%1/%2/%3").arg(QMozThumbnailProvider::providerId())
+                                                  .arg(uniqueId).arg(revision));
+}
+
+void QMozThumbnailCache::remove(quint32 uniqueId)
+{
+    Q_D(QMozThumbnailCache);
+    d->remove(uniqueId);
+}
+
+void QMozThumbnailCache::clear()
+{
+    Q_D(QMozThumbnailCache);
+    d->clear();
+}
+
+/*!
+    \fn bool QMozThumbnailCache::update(QMozOpenGLWebPage *webPage, const QSize &size)
+
+    Grabs a new thumbnail of at most \a size for \a webPage if it has painted
+    since the cached one was taken. The grab is downscaled on the GPU and
+    stored once ready. Returns true if a grab was requested.
+*/
+bool QMozThumbnailCache::update(QMozOpenGLWebPage *webPage, const QSize &size)
+{
+    Q_D(QMozThumbnailCache);
+    if (!webPage || !webPage->completed() || !d->needsUpdate(webPage->uniqueId())) {
+        return false;
+    }
+
+    QSharedPointer<QMozGrabResult> result = webPage->grabToImage(size, QSize());
+    if (!result) {
+        return false;
+    }
+    d->trackGrab(webPage->uniqueId(), result);
+    return true;
+}
+
+/*!
+    \fn bool QMozThumbnailCache::update(QuickMozView *view, const QSize &size)
+
+    Same as above for \a view, the grab is read from the view texture.
+*/
+bool QMozThumbnailCache::update(QuickMozView *view, const QSize &size)
+{
+    Q_D(QMozThumbnailCache);
+    if (!view || !view->active() || !d->needsUpdate(view->uniqueId())) {
+        return false;
+    }
+
+    QSharedPointer<QMozGrabResult> result = view->grabContentToImage(size);
+    if (!result) {
+        return false;
+    }
+    d->trackGrab(view->uniqueId(), result);
+    return true;
+}
+
+QMozThumbnailProvider::QMozThumbnailProvider()
+    : QQuickImageProvider(QQuickImageProvider::Image)
+{
+}
+
+QImage QMozThumbnailProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+{
+    // id is "<uniqueId>/<revision>", revision only busts the QML image cache.
+    bool ok = false;
+    const quint32 uniqueId = id.section(QLatin1Char('/'), 0, 0).toUInt(&ok);
+    if (!ok) {
+        return QImage();
+    }
+
+    QImage image = QMozThumbnailCachePrivate::instance()->thumbnail(uniqueId);
+    if (size) {
+        *size = image.size();
+    }
+
+    if (!image.isNull() && (requestedSize.width() > 0 || requestedSize.height() > 0)) {
+        const QSize bounds(requestedSize.width() > 0 ? requestedSize.width() : image.width(),
+                           requestedSize.height() > 0 ? requestedSize.height() : image.height());
+        if (bounds.width() < image.width() || bounds.height() < image.height()) {
+            image = image.scaled(bounds, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+    }
+    return image;
+}
+
+QString QMozThumbnailProvider::providerId()
+{
+    return QStringLiteral("mozthumbnail");
+}
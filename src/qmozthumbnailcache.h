@@ -0,0 +1,78 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef QMOZTHUMBNAILCACHE_H
+#define QMOZTHUMBNAILCACHE_H
+
+#include <QObject>
+#include <QImage>
+#include <QSize>
+#include <QUrl>
+#include <QQuickImageProvider>
+
+class QMozOpenGLWebPage;
+class QuickMozView;
+class QMozThumbnailCachePrivate;
+
+/*
+ * Memory bounded cache of web view thumbnails keyed by view uniqueId.
+ *
+ * Least recently used thumbnails are compressed and, once the byte budget is
+ * exceeded, evicted. QML reads thumbnails through the "mozthumbnail" image
+ * provider using the url() of a view so that images never cross into JS.
+ */
+class QMozThumbnailCache : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int budget READ budget WRITE setBudget NOTIFY budgetChanged FINAL)
+    Q_PROPERTY(int cost READ cost NOTIFY costChanged FINAL)
+
+public:
+    // C++ API
+    static QMozThumbnailCache *instance();
+
+    // For QML plugin
+    explicit QMozThumbnailCache(QObject *parent = 0);
+    ~QMozThumbnailCache();
+
+    int budget() const;
+    void setBudget(int bytes);
+
+    int cost() const;
+
+    void insert(quint32 uniqueId, const QImage &image);
+    QImage thumbnail(quint32 uniqueId);
+
+    Q_INVOKABLE bool contains(quint32 uniqueId) const;
+    Q_INVOKABLE bool needsUpdate(quint32 uniqueId) const;
+    Q_INVOKABLE QUrl url(quint32 uniqueId) const;
+    Q_INVOKABLE void remove(quint32 uniqueId);
+    Q_INVOKABLE void clear();
+
+    bool update(QMozOpenGLWebPage *webPage, const QSize &size);
+    bool update(QuickMozView *view, const QSize &size);
+
+Q_SIGNALS:
+    void budgetChanged();
+    void costChanged();
+    void thumbnailChanged(quint32 uniqueId);
+
+private:
+    QMozThumbnailCachePrivate *d_ptr;
+    Q_DISABLE_COPY(QMozThumbnailCache)
+    Q_DECLARE_PRIVATE(QMozThumbnailCache)
+};
+
+class QMozThumbnailProvider : public QQuickImageProvider
+{
+public:
+    QMozThumbnailProvider();
+
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize) override;
+
+    static QString providerId();
+};
+
+#endif // QMOZTHUMBNAILCACHE_H
@@ -0,0 +1,90 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef QMOZTHUMBNAILCACHE_P_H
+#define QMOZTHUMBNAILCACHE_P_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+
+#include "qmozthumbnailcache.h"
+
+class QMozGrabResult;
+
+class QMozThumbnailCachePrivate : public QObject
+{
+    Q_OBJECT
+
+public:
+    static QMozThumbnailCachePrivate *instance();
+
+    // Safe to call from any thread, including the compositor thread.
+    // These do nothing until the cache has been used.
+    static void notifyPainted(quint32 uniqueId);
+    static void viewDestroyed(quint32 uniqueId);
+    // Removes and returns the thumbnail of uniqueId, if any.
+    static QImage take(quint32 uniqueId);
+
+    explicit QMozThumbnailCachePrivate(QObject *parent = 0);
+    ~QMozThumbnailCachePrivate();
+
+    int budget() const;
+    void setBudget(int bytes);
+    int cost() const;
+
+    void insert(quint32 uniqueId, const QImage &image);
+    QImage thumbnail(quint32 uniqueId);
+    bool contains(quint32 uniqueId) const;
+    bool needsUpdate(quint32 uniqueId) const;
+    int revision(quint32 uniqueId) const;
+    void remove(quint32 uniqueId);
+    void clear();
+    void trackGrab(quint32 uniqueId, const QSharedPointer<QMozGrabResult> &result);
+
+    void storeCompressed(quint32 uniqueId, int revision, const QByteArray &data);
+
+Q_SIGNALS:
+    void budgetChanged();
+    void costChanged();
+    void thumbnailChanged(quint32 uniqueId);
+
+private Q_SLOTS:
+    void compressColdEntries();
+
+private:
+    struct Entry {
+        QImage image;
+        QByteArray compressed;
+        int cost = 0;
+        int revision = 0;
+        // Revision being compressed on the thread pool, 0 if none.
+        int compressingRevision = 0;
+        quint64 paintSerial = 0;
+    };
+
+    void insert(quint32 uniqueId, const QImage &image, quint64 paintSerial);
+    void touch(quint32 uniqueId);
+    void setCost(Entry &entry, int cost);
+    void evict();
+    void scheduleCompression();
+
+    mutable QMutex mMutex;
+    QHash<quint32, Entry> mEntries;
+    // Most recently used first.
+    QList<quint32> mRecentlyUsed;
+    QHash<quint32, quint64> mPaintSerials;
+    QHash<quint32, QSharedPointer<QMozGrabResult> > mPendingGrabs;
+    int mBudget;
+    int mCost;
+    int mNextRevision;
+    bool mCompressionScheduled;
+};
+
+#endif // QMOZTHUMBNAILCACHE_P_H
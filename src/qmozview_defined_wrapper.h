@@ -22,18 +22,25 @@
 #include <QPointF>
 #include <QMargins>
 
+#include <functional>
+
 class QMozScrollDecorator;
 
+// Receives the result of runJavaScript(), or an error message on failure.
+typedef std::function<void(const QVariant &result, const QString &error)> QMozJavaScriptCallback;
+
 class QMozReturnValue : public QObject
 {
     Q_OBJECT
     Q_PROPERTY(QVariant message READ getMessage WRITE setMessage FINAL)
 
 public:
-    QMozReturnValue(QObject *parent = 0) : QObject(parent) {}
+    QMozReturnValue(QObject *parent = 0) : QObject(parent), mToken(0), mDeferred(false) {}
     QMozReturnValue(const QMozReturnValue &aMsg) : QObject(nullptr)
     {
         mMessage = aMsg.mMessage;
+        mToken = aMsg.mToken;
+        mDeferred = aMsg.mDeferred;
     }
     virtual ~QMozReturnValue() {}
 
@@ -46,8 +53,25 @@ public:
         mMessage = msg;
     }
 
+    // Replies later, pass the returned token to replySyncMessage() of the view.
+    Q_INVOKABLE uint defer()
+    {
+        mDeferred = true;
+        return mToken;
+    }
+    bool isDeferred() const
+    {
+        return mDeferred;
+    }
+    void setToken(uint token)
+    {
+        mToken = token;
+    }
+
 private:
     QVariant mMessage;
+    uint mToken;
+    bool mDeferred;
 };
 
 Q_DECLARE_METATYPE(QMozReturnValue)
@@ -58,13 +82,18 @@ class QMozReturnValue : public QObject \
     Q_OBJECT \
     Q_PROPERTY(QVariant message READ getMessage WRITE setMessage FINAL) \
 public: \
-    QMozReturnValue(QObject *parent = 0) : QObject(parent) {} \
-    QMozReturnValue(const QMozReturnValue &aMsg) : QObject(nullptr) { mMessage = aMsg.mMessage; } \
+    QMozReturnValue(QObject *parent = 0) : QObject(parent), mToken(0), mDeferred(false) {} \
+    QMozReturnValue(const QMozReturnValue &aMsg) : QObject(nullptr) { mMessage = aMsg.mMessage; mToken = aMsg.mToken; mDeferred = aMsg.mDeferred; } \
     virtual ~QMozReturnValue() {} \
     QVariant getMessage() const { return mMessage; } \
     void setMessage(const QVariant &msg) { mMessage = msg; } \
+    Q_INVOKABLE uint defer() { mDeferred = true; return mToken; } \
+    bool isDeferred() const { return mDeferred; } \
+    void setToken(uint token) { mToken = token; } \
 private: \
     QVariant mMessage; \
+    uint mToken; \
+    bool mDeferred; \
 }; \
 Q_DECLARE_METATYPE(QMozReturnValue) \
 
@@ -96,6 +125,7 @@ Q_DECLARE_METATYPE(QMozReturnValue) \
     Q_PROPERTY(bool chromeGestureEnabled READ chromeGestureEnabled WRITE setChromeGestureEnabled NOTIFY chromeGestureEnabledChanged FINAL) \
     Q_PROPERTY(qreal chromeGestureThreshold READ chromeGestureThreshold WRITE setChromeGestureThreshold NOTIFY chromeGestureThresholdChanged FINAL) \
     Q_PROPERTY(QMozSecurity *security READ security NOTIFY securityChanged FINAL) \
+    Q_PROPERTY(QMozViewDiagnostics *diagnostics READ diagnostics CONSTANT FINAL) \
     Q_PROPERTY(bool desktopMode READ desktopMode WRITE setDesktopMode NOTIFY desktopModeChanged FINAL) \
     Q_PROPERTY(int parentId READ parentId NOTIFY parentIdChanged FINAL) \
     Q_PROPERTY(int uniqueId READ uniqueId NOTIFY uniqueIdChanged FINAL) \
@@ -144,6 +174,7 @@ Q_DECLARE_METATYPE(QMozReturnValue) \
     Q_INVOKABLE void scrollTo(int x, int y); \
     Q_INVOKABLE void scrollBy(int x, int y); \
     QMozSecurity *security(); \
+    QMozViewDiagnostics *diagnostics(); \
     void addMessageListeners(const std::vector<std::string> &messageNamesList); \
     bool desktopMode() const; \
     void setDesktopMode(bool); \
@@ -154,6 +185,8 @@ Q_DECLARE_METATYPE(QMozReturnValue) \
     Q_INVOKABLE void runJavaScript(const QString &script, \
                                const QJSValue &callback = QJSValue::UndefinedValue, \
                                const QJSValue &errorCallback = QJSValue::UndefinedValue); \
+    void runJavaScript(const QString &script, const QMozJavaScriptCallback &callback); \
+    Q_INVOKABLE void replySyncMessage(uint token, const QVariant &message); \
 
 #define Q_MOZ_VIEW_PUBLIC_SLOTS \
     void loadHtml(const QString &html, const QUrl &baseUrl = QUrl()); \
@@ -14,6 +14,7 @@
 #include <QJSEngine>
 #include <QJsonDocument>
 #include <QJsonParseError>
+#include <QThread>
 #include <QTimer>
 #include <QTouchEvent>
 #include <QQuickWindow>
@@ -37,6 +38,9 @@
 #include "qmozview_p.h"
 #include "qmozwindow_p.h"
 #include "qmozcontext.h"
+#include "qmozcontext_p.h"
+#include "qmozthumbnailcache_p.h"
+#include "qmozviewpool_p.h"
 #include "qmozenginesettings.h"
 #include "EmbedQtKeyUtils.h"
 #include "qmozembedlog.h"
@@ -66,9 +70,115 @@ using namespace mozilla::embedlite;
 #define INPUTMETHOD_RESET_INPUT_CONTEXT "InputMethodHandler:ResetInputContext"
 #define INPUTMETHOD_SET_INPUT_ATTRIBUTES "InputMethodHandler:SetInputAttributes"
 #define INPUTMETHOD_RESET_INPUT_ATTRIBUTES "InputMethodHandler:ResetInputAttributes"
+#define INPUTMETHOD_CONTEXT_OPTIONS "embedui:inputContextOptions"
+#define INPUTMETHOD_REQUEST_INPUT_CONTEXT "embedui:requestInputContext"
+#define SYNC_MESSAGE_REPLY "embedui:syncMessageReply"
 #define DOCURI_KEY "docuri"
 #define ABOUT_URL_PREFIX "about:"
 
+namespace {
+// Refresh driver rate of each QMozContext::ViewTier. EmbedLite only offers the
+// full rate and the throttled one (layout.throttled_frame_rate) per view, so
+// visible views keep painting at the full rate and every background tier
+// shares the throttled rate. Background tiers differ in timeout suspension.
+enum RefreshRate {
+    FullRate,
+    ThrottledRate
+};
+
+constexpr RefreshRate sTierRefreshRate[] = {
+    FullRate,      // ForegroundTier
+    FullRate,      // VisibleTier
+    ThrottledRate, // BackgroundRecentTier
+    ThrottledRate, // BackgroundOldTier
+    ThrottledRate  // FrozenTier
+};
+
+static_assert(sizeof(sTierRefreshRate) / sizeof(sTierRefreshRate[0]) == QMozContext::FrozenTier + 1,
+              "sTierRefreshRate must cover every QMozContext::ViewTier");
+}
+
+// Preedit-only composition updates are coalesced for at most this long.
+#ifndef MOZVIEW_COMPOSITION_INTERVAL
+#define MOZVIEW_COMPOSITION_INTERVAL 16
+#endif
+
+// Characters of surrounding text requested around the cursor.
+#ifndef MOZVIEW_SURROUNDING_TEXT_WINDOW
+#define MOZVIEW_SURROUNDING_TEXT_WINDOW 1024
+#endif
+
+// Time after which a deferred sync message reply is answered with an error.
+#ifndef MOZVIEW_SYNC_REPLY_TIMEOUT
+#define MOZVIEW_SYNC_REPLY_TIMEOUT 10000
+#endif
+
+namespace {
+const QEvent::Type Event_QueuedCall = static_cast<QEvent::Type>(QEvent::registerEventType());
+
+// Carries a call made from another thread to the thread of the view.
+class QueuedCallEvent : public QEvent
+{
+public:
+    QueuedCallEvent(const std::function<void()> &call)
+        : QEvent(Event_QueuedCall)
+        , call(call)
+    {
+    }
+
+    std::function<void()> call;
+};
+
+QJsonDocument toJsonDocument(const QVariant &value)
+{
+    if (value.userType() == QMetaType::type("QJSValue")) {
+        // Qt 5.6 likes to pass a QJSValue
+        QJSValue jsValue = qvariant_cast<QJSValue>(value);
+        return QJsonDocument::fromVariant(jsValue.toVariant());
+    }
+    return QJsonDocument::fromVariant(value);
+}
+}
+
+// Time to wait for form data before a view is discarded without it.
+#ifndef MOZVIEW_DISCARD_TIMEOUT
+#define MOZVIEW_DISCARD_TIMEOUT 1000
+#endif
+
+// Collects values of user editable form fields, keyed by document order.
+// Scripts run as a function body, so the result has to be returned.
+static const char *const sCollectFormDataScript =
+        "return (function() {"
+        "  var fields = [];"
+        "  var elements = document.querySelectorAll('input, textarea, select');"
+        "  for (var i = 0; i < elements.length; ++i) {"
+        "    var e = elements[i];"
+        "    if (e.type === 'password' || e.type === 'hidden' || e.type === 'file') continue;"
+        "    var checkable = e.type === 'checkbox' || e.type === 'radio';"
+        "    if (checkable ? e.checked === e.defaultChecked : e.value === e.defaultValue) continue;"
+        "    fields.push({ index: i, id: e.id || e.name || '', value: checkable ? e.checked : e.value });"
+        "  }"
+        "  return fields;"
+        "})()";
+
+// Restores form fields, zoom and scroll position. The saved resolution is in
+// window pixels per CSS pixel, the pres shell resolution excludes the device
+// pixel ratio. Zoom goes first as it limits the scroll range. It needs
+// windowUtils, which is only there when the script runs with chrome privileges.
+static const char *const sRestoreStateScript =
+        "(function(fields, x, y, resolution) {"
+        "  var elements = document.querySelectorAll('input, textarea, select');"
+        "  fields.forEach(function(field) {"
+        "    var e = elements[field.index];"
+        "    if (!e || (e.id || e.name || '') !== field.id) return;"
+        "    if (e.type === 'checkbox' || e.type === 'radio') e.checked = field.value; else e.value = field.value;"
+        "  });"
+        "  if (resolution > 0 && window.windowUtils) {"
+        "    window.windowUtils.setResolutionAndScaleTo(resolution / window.devicePixelRatio);"
+        "  }"
+        "  window.scrollTo(x, y);"
+        "})(%1, %2, %3, %4)";
+
 static qint64 current_timestamp(QTouchEvent *aEvent)
 {
     if (aEvent) {
@@ -154,6 +264,12 @@ QMozViewPrivate::QMozViewPrivate(IMozQViewIface *aViewIface, QObject *publicPtr)
     , mInputMethodAttributes(0)
     , mIsInputFieldFocused(false)
     , mPreedit(false)
+    , mCompositionPending(false)
+    , mCompositionTimerId(0)
+    , mInputCommitScheduled(false)
+    , mPendingInputMethodQueries(0)
+    , mSurroundingTextVersion(0)
+    , mInputContextRequested(false)
     , mViewIsFocused(false)
     , mPressed(false)
     , mDragging(false)
@@ -165,8 +281,18 @@ QMozViewPrivate::QMozViewPrivate(IMozQViewIface *aViewIface, QObject *publicPtr)
     , mDepth(0)
     , mDpi(0.0)
     , mNextJSCallId(0)
+    , mNextSyncReplyToken(1)
     , mAutoCompleteActive(false)
     , mAutoCompleteList()
+    , mTier(QMozContext::ForegroundTier)
+    , mLastShownTime(0)
+    , mThrottlePainting(false)
+    , mTimeoutsSuspended(false)
+    , mGeckoTimeoutsSuspended(false)
+    , mDiscardable(false)
+    , mDiscardPending(false)
+    , mDiscarded(false)
+    , mStartupMarks(0)
     , mDirtyState(0)
     , mPendingFromExternal(false)
 {
@@ -189,10 +315,15 @@ QMozViewPrivate::QMozViewPrivate(IMozQViewIface *aViewIface, QObject *publicPtr)
         }
         sendScreenProperties();
     });
+    QMozContextPrivate::instance()->registerView(this);
 }
 
 QMozViewPrivate::~QMozViewPrivate()
 {
+    if (QMozContextPrivate *context = QMozContextPrivate::instance()) {
+        context->unregisterView(this);
+    }
+
     delete mViewIface;
     mViewIface = nullptr;
     mViewInitialized = false;
@@ -649,6 +780,48 @@ void QMozViewPrivate::runJavaScript(const QString &script, const QJSValue &callb
     mPendingJSCalls.insert(callbackId, qMakePair(callback, errorCallback));
 }
 
+/*
+ * Native counterpart of the QJSValue based runJavaScript(), no QML engine
+ * is involved. May be called from any thread, the call is then queued to
+ * the thread of the view and the callback is called there. Callbacks of a
+ * view that is destroyed first are never called.
+ */
+void QMozViewPrivate::runJavaScript(const QString &script, const JavaScriptCallback &callback)
+{
+    if (QThread::currentThread() != thread()) {
+        QCoreApplication::postEvent(this, new QueuedCallEvent([this, script, callback]() {
+            runJavaScript(script, callback);
+        }));
+        return;
+    }
+
+    if (!mViewInitialized) {
+        if (callback) {
+            callback(QVariant(), QStringLiteral("Error: run javascript can be called only after view is initialized."));
+        }
+        return;
+    }
+
+    sendJavaScript(script, callback);
+}
+
+// Sends the script of an initialized view to content. Returns the id under
+// which the callback is pending, or uint(-1) without a callback.
+uint QMozViewPrivate::sendJavaScript(const QString &script, const JavaScriptCallback &callback)
+{
+    const uint callbackId = callback ? mNextJSCallId++ : uint(-1);
+
+    QVariantMap data;
+    data.insert(QString("script"), script);
+    data.insert(QString("callbackId"), callback ? QVariant(callbackId) : QVariant(-1));
+    doSendAsyncMessage(QLatin1String(RUN_JAVASCRIPT), QVariant(data));
+
+    if (callback) {
+        mPendingNativeJSCalls.insert(callbackId, callback);
+    }
+    return callbackId;
+}
+
 bool QMozViewPrivate::domContentLoaded() const
 {
     return mDOMContentLoaded;
@@ -660,6 +833,7 @@ void QMozViewPrivate::loadFrameScript(const QString &frameScript)
         mPendingFrameScripts.append(frameScript);
     } else {
         mView->LoadFrameScript(frameScript.toUtf8().data());
+        mFrameScripts.append(frameScript);
     }
 }
 
@@ -671,6 +845,7 @@ void QMozViewPrivate::addMessageListener(const std::string &name)
     }
 
     mView->AddMessageListener(name.c_str());
+    mMessageListeners.push_back(name);
 }
 
 void QMozViewPrivate::addMessageListeners(const std::vector<std::string> &messageNamesList)
@@ -683,6 +858,7 @@ void QMozViewPrivate::addMessageListeners(const std::vector<std::string> &messag
     }
 
     mView->AddMessageListeners(messageNamesList);
+    mMessageListeners.insert(mMessageListeners.end(), messageNamesList.begin(), messageNamesList.end());
 }
 
 void QMozViewPrivate::timerEvent(QTimerEvent *event)
@@ -699,9 +875,21 @@ void QMozViewPrivate::timerEvent(QTimerEvent *event)
         mOffsetX = offsetX;
         mOffsetY = offsetY;
         event->accept();
+    } else if (event->timerId() == mCompositionTimerId) {
+        flushComposition();
+        event->accept();
     }
 }
 
+bool QMozViewPrivate::event(QEvent *event)
+{
+    if (event->type() == Event_QueuedCall) {
+        static_cast<QueuedCallEvent *>(event)->call();
+        return true;
+    }
+    return QObject::event(event);
+}
+
 void QMozViewPrivate::startMoveMonitor()
 {
     Q_ASSERT(q);
@@ -749,22 +937,38 @@ void QMozViewPrivate::inputMethodEvent(QInputMethodEvent *event)
         int asciiNumber = event->commitString().toInt(&ok) + Qt::Key_0;
         if (ok && (mInputMethodHints & Qt::ImhFormattedNumbersOnly
                    || mInputMethodHints & Qt::ImhDialableCharactersOnly)) {
+            flushComposition();
             int32_t domKeyCode = MozKey::QtKeyCodeToDOMKeyCode(asciiNumber, Qt::NoModifier);
             mView->SendKeyPress(domKeyCode, 0, charCode);
             mView->SendKeyRelease(domKeyCode, 0, charCode);
             qGuiApp->inputMethod()->reset();
 
+        } else if (event->commitString().isEmpty() && event->replacementLength() == 0
+                   && !event->preeditString().isEmpty()) {
+            // Each preedit replaces the previous one, only the latest matters.
+            mPendingPreedit = event->preeditString();
+            mCompositionPending = true;
+            if (!mCompositionTimerId) {
+                mCompositionTimerId = startTimer(MOZVIEW_COMPOSITION_INTERVAL);
+            }
+            scheduleInputCommit();
         } else {
+            // A commit without replacement ends the composition and supersedes
+            // a pending preedit. Replacements refer to the current content, so
+            // the preedit has to reach the engine first.
+            if (event->replacementLength() > 0) {
+                flushComposition();
+            } else {
+                cancelComposition();
+            }
+
             if (mPreedit || !event->commitString().isEmpty()
                     || !event->preeditString().isEmpty()
                     || event->replacementLength() > 0) {
                 mView->SendTextEvent(event->commitString().toUtf8().data(), event->preeditString().toUtf8().data(),
                                      event->replacementStart(), event->replacementLength());
                 if (event->commitString().isEmpty() && !event->preeditString().isEmpty()) {
-                    QInputMethod *inputContext = qGuiApp->inputMethod();
-                    if (inputContext) {
-                        QTimer::singleShot(0, inputContext, &QInputMethod::commit);
-                    }
+                    scheduleInputCommit();
                 }
             }
         }
@@ -772,11 +976,73 @@ void QMozViewPrivate::inputMethodEvent(QInputMethodEvent *event)
     mPreedit = !event->preeditString().isEmpty();
 }
 
+/*
+ * Predictive keyboards send a burst of preedit updates while typing. The
+ * latest one is held back until the next text, key, touch or mouse event
+ * or loss of focus, or for at most MOZVIEW_COMPOSITION_INTERVAL, so that
+ * the engine sees the events in order but not every intermediate
+ * composition.
+ */
+void QMozViewPrivate::flushComposition()
+{
+    if (!mCompositionPending) {
+        return;
+    }
+
+    const QByteArray preedit = mPendingPreedit.toUtf8();
+    cancelComposition();
+    if (mViewInitialized) {
+        mView->SendTextEvent("", preedit.constData(), 0, 0);
+    }
+}
+
+void QMozViewPrivate::cancelComposition()
+{
+    mCompositionPending = false;
+    mPendingPreedit.clear();
+    if (mCompositionTimerId) {
+        killTimer(mCompositionTimerId);
+        mCompositionTimerId = 0;
+    }
+}
+
+void QMozViewPrivate::scheduleInputCommit()
+{
+    if (mInputCommitScheduled) {
+        return;
+    }
+
+    mInputCommitScheduled = true;
+    QTimer::singleShot(0, this, [this]() {
+        mInputCommitScheduled = false;
+        if (QInputMethod *inputContext = qGuiApp->inputMethod()) {
+            inputContext->commit();
+        }
+    });
+}
+
+// Input method queries changed by engine messages are announced once per event loop pass.
+void QMozViewPrivate::updateInputMethod(Qt::InputMethodQueries queries)
+{
+    if (!mPendingInputMethodQueries) {
+        QTimer::singleShot(0, this, [this]() {
+            Qt::InputMethodQueries queries = mPendingInputMethodQueries;
+            mPendingInputMethodQueries = 0;
+            if (QInputMethod *inputContext = qGuiApp->inputMethod()) {
+                inputContext->update(queries);
+            }
+        });
+    }
+    mPendingInputMethodQueries |= queries;
+}
+
 void QMozViewPrivate::keyPressEvent(QKeyEvent *event)
 {
     if (!mViewInitialized)
         return;
 
+    flushComposition();
+
     int32_t gmodifiers = MozKey::QtModifierToDOMModifier(event->modifiers());
     int32_t domKeyCode = MozKey::QtKeyCodeToDOMKeyCode(event->key(), event->modifiers());
     int32_t charCode = 0;
@@ -794,6 +1060,8 @@ void QMozViewPrivate::keyReleaseEvent(QKeyEvent *event)
     if (!mViewInitialized)
         return;
 
+    flushComposition();
+
     int32_t gmodifiers = MozKey::QtModifierToDOMModifier(event->modifiers());
     int32_t domKeyCode = MozKey::QtKeyCodeToDOMKeyCode(event->key(), event->modifiers());
     int32_t charCode = 0;
@@ -948,16 +1216,44 @@ void QMozViewPrivate::createView()
 
         Q_ASSERT(mMozWindow);
 
-        EmbedLiteWindow *win = mMozWindow->d->mWindow;
-        mView = mContext->GetApp()->CreateView(win, mParentID, mParentBrowsingContext,
-                                               mPrivateMode, mDesktopMode, mHidden);
+        mCreationTimer.start();
+
+        // Pooled views have no parent, are not hidden and not in desktop mode.
+        if (!mParentID && !mParentBrowsingContext && !mHidden && !mDesktopMode) {
+            mView = QMozContextPrivate::instance()->viewPool()->take(mMozWindow, mPrivateMode);
+        }
+
+        const bool pooled = mView;
+        if (!pooled) {
+            EmbedLiteWindow *win = mMozWindow->d->mWindow;
+            mView = mContext->GetApp()->CreateView(win, mParentID, mParentBrowsingContext,
+                                                   mPrivateMode, mDesktopMode, mHidden);
+        }
         mView->SetListener(this);
+        markStartup(StartupCreateView, "CreateView");
         setScreenProperties(QGuiApplication::primaryScreen()->depth(),
                             QGuiApplication::primaryScreen()->physicalDotsPerInch());
 
         if (mozView) {
             connect(mMozWindow.data(), &QMozWindow::compositingFinished,
-                    mozView, &QuickMozView::compositingFinished);
+                    mozView, &QuickMozView::compositingFinished, Qt::UniqueConnection);
+        }
+
+        if (pooled) {
+            if (mDesktopMode) {
+                mView->SetDesktopMode(true);
+            }
+            // Already initialized, deliver it the way the engine would.
+            QTimer::singleShot(0, this, [this]() {
+                if (mView && !mViewInitialized) {
+                    ViewInitialized();
+                }
+            });
+        }
+
+        if (!mDiscardedThumbnail.isNull()) {
+            QMozThumbnailCachePrivate::instance()->insert(mView->GetUniqueID(), mDiscardedThumbnail);
+            mDiscardedThumbnail = QImage();
         }
 
         mViewIface->uniqueIdChanged();
@@ -967,6 +1263,8 @@ void QMozViewPrivate::createView()
 void QMozViewPrivate::ViewInitialized()
 {
     mViewInitialized = true;
+    QMozContextPrivate::instance()->viewPool()->recordCreation(mCreationTimer.elapsed());
+    markStartup(StartupViewInitialized, "ViewInitialized");
 
     // Load frame scripts first and then message listeners.
     Q_FOREACH (const QString &frameScript, mPendingFrameScripts) {
@@ -1013,6 +1311,15 @@ void QMozViewPrivate::ViewInitialized()
         mView->SetHttpUserAgent((const char16_t *)mHttpUserAgent.utf16());
     }
 
+    applyTier();
+
+    // Input contexts are sent as a window around the cursor and as
+    // incremental edits where the content side supports that.
+    QVariantMap inputContextOptions;
+    inputContextOptions.insert(QStringLiteral("window"), MOZVIEW_SURROUNDING_TEXT_WINDOW);
+    inputContextOptions.insert(QStringLiteral("edits"), true);
+    doSendAsyncMessage(QLatin1String(INPUTMETHOD_CONTEXT_OPTIONS), inputContextOptions);
+
     // This is currently part of official API, so let's subscribe to these messages by default
     mViewIface->viewInitialized();
     mViewIface->canGoBackChanged();
@@ -1119,6 +1426,8 @@ void QMozViewPrivate::OnLoadStarted(const char *aLocation)
 
 void QMozViewPrivate::OnLoadFinished(void)
 {
+    markStartup(StartupLoadFinished, "LoadFinished");
+
     // if loading has stopped before location change, restore back
     // previous none empty url. Normally OnLocationChange clears pending url.
     if (!mPendingUrl.isEmpty() && !mUrl.isEmpty() && (mUrl != mPendingUrl)) {
@@ -1133,6 +1442,21 @@ void QMozViewPrivate::OnLoadFinished(void)
         mViewIface->loadingChanged();
     }
 
+    // Re-apply form data, zoom and scroll position of a restored view.
+    if (!mDiscarded && !mDiscardedState.isEmpty()
+            && mUrl == mDiscardedState.value(QStringLiteral("url")).toString()) {
+        const QVariant formData = mDiscardedState.value(QStringLiteral("formData"));
+        const QByteArray fields = QJsonDocument::fromVariant(formData.isValid() ? formData.toList() : QVariantList())
+                .toJson(QJsonDocument::Compact);
+        runJavaScript(QString(QLatin1String(sRestoreStateScript))
+                      .arg(QString::fromUtf8(fields),
+                           QString::number(mDiscardedState.value(QStringLiteral("scrollX")).toReal()),
+                           QString::number(mDiscardedState.value(QStringLiteral("scrollY")).toReal()),
+                           QString::number(mDiscardedState.value(QStringLiteral("resolution")).toReal())),
+                      QJSValue(), QJSValue());
+        mDiscardedState.clear();
+    }
+
     if (mMozWindow) {
         if (mViewInitialized && mView) {
             mView->ScheduleUpdate();
@@ -1141,6 +1465,90 @@ void QMozViewPrivate::OnLoadFinished(void)
     }
 }
 
+/*
+ * Saves the restorable state of an inactive view and destroys its
+ * EmbedLiteView. Form data is collected from the page first, the view is
+ * recreated by restore(). Returns false if the view cannot be discarded.
+ */
+bool QMozViewPrivate::discard()
+{
+    if (!mDiscardable || !mViewInitialized || mActive || mDiscardPending) {
+        return false;
+    }
+
+    mDiscardPending = true;
+    const uint callbackId = sendJavaScript(QLatin1String(sCollectFormDataScript),
+                                           [this](const QVariant &result, const QString &error) {
+        Q_UNUSED(error)
+        if (mDiscardPending) {
+            finishDiscard(result);
+        }
+    });
+
+    QTimer::singleShot(MOZVIEW_DISCARD_TIMEOUT, this, [this, callbackId]() {
+        if (mDiscardPending && mPendingNativeJSCalls.remove(callbackId)) {
+            finishDiscard(QVariant());
+        }
+    });
+    return true;
+}
+
+void QMozViewPrivate::finishDiscard(const QVariant &formData)
+{
+    mDiscardPending = false;
+    if (mActive || !mViewInitialized) {
+        return;
+    }
+
+    const quint32 uniqueId = mView->GetUniqueID();
+
+    mDiscardedState.clear();
+    mDiscardedState.insert(QStringLiteral("url"), mUrl);
+    mDiscardedState.insert(QStringLiteral("title"), mTitle);
+    mDiscardedState.insert(QStringLiteral("scrollX"), mContentRect.x());
+    mDiscardedState.insert(QStringLiteral("scrollY"), mContentRect.y());
+    mDiscardedState.insert(QStringLiteral("resolution"), mContentResolution);
+    mDiscardedState.insert(QStringLiteral("formData"), formData);
+    mDiscardedThumbnail = QMozThumbnailCachePrivate::take(uniqueId);
+
+    // Replay frame scripts and message listeners to the recreated view.
+    mPendingFrameScripts = mFrameScripts;
+    mFrameScripts.clear();
+    mPendingMessageListeners = mMessageListeners;
+    mMessageListeners.clear();
+
+    // Pending JS calls can never be answered.
+    mPendingJSCalls.clear();
+    mPendingNativeJSCalls.clear();
+
+    if (mGeckoTimeoutsSuspended) {
+        mView->ResumeTimeouts();
+        mGeckoTimeoutsSuspended = false;
+    }
+    mView->SetListener(nullptr);
+    mContext->GetApp()->DestroyView(mView);
+    mView = nullptr;
+    mViewInitialized = false;
+    mDirtyState |= DirtySize | DirtyMargin | DirtySafeAreaInsets;
+
+    mDiscarded = true;
+    qCDebug(lcEmbedLiteExt) << "Discarded view" << uniqueId << mUrl;
+    Q_EMIT discardedChanged();
+}
+
+void QMozViewPrivate::restore()
+{
+    if (!mDiscarded) {
+        return;
+    }
+
+    mDiscarded = false;
+    mPendingUrl = mDiscardedState.value(QStringLiteral("url")).toString();
+    mPendingFromExternal = false;
+    createView();
+    Q_EMIT discardedChanged();
+}
+
 void QMozViewPrivate::OnWindowCloseRequested()
 {
     mViewIface->windowCloseRequested();
@@ -1181,8 +1589,11 @@ void QMozViewPrivate::RecvAsyncMessage(const char16_t *aMessage, const char16_t
 #ifdef DEVELOPMENT_BUILD
         qCDebug(lcEmbedLiteExt) << "mesg:" << message << ", data:" << data;
 #endif
+        QElapsedTimer handlerTimer;
+        handlerTimer.start();
         if (!handleAsyncMessage(message, vdata))
             mViewIface->recvAsyncMessage(message, vdata);
+        mDiagnostics.record(message, QMozViewDiagnostics::AsyncMessage, handlerTimer.nsecsElapsed());
     } else {
         qCWarning(lcEmbedLiteExt) << "JSON parse error:" << error.errorString();
 #ifdef DEVELOPMENT_BUILD
@@ -1191,9 +1602,18 @@ void QMozViewPrivate::RecvAsyncMessage(const char16_t *aMessage, const char16_t
     }
 }
 
+/*
+ * The content side is blocked until this returns. A handler that needs
+ * more time calls defer() on the response and later passes the returned
+ * token to replySyncMessage(), the content side then gets {"deferred":
+ * token} right away and the actual reply as an embedui:syncMessageReply
+ * message. Without a reply within MOZVIEW_SYNC_REPLY_TIMEOUT an error is
+ * sent instead.
+ */
 char *QMozViewPrivate::RecvSyncMessage(const char16_t *aMessage, const char16_t *aData)
 {
     QMozReturnValue response;
+    response.setToken(mNextSyncReplyToken);
 
     QString message = QString::fromUtf16(aMessage);
     QString data = QString::fromUtf16(aData);
@@ -1203,24 +1623,63 @@ char *QMozViewPrivate::RecvSyncMessage(const char16_t *aMessage, const char16_t
     Q_ASSERT(error.error == QJsonParseError::NoError);
     QVariant vdata = doc.toVariant();
 
+    QElapsedTimer handlerTimer;
+    handlerTimer.start();
     mViewIface->recvSyncMessage(message, vdata, &response);
+    mDiagnostics.record(message, QMozViewDiagnostics::BlockingMessage, handlerTimer.nsecsElapsed());
 
     QVariant responseMessage = response.getMessage();
     QJsonDocument responseDocument;
-    if (!responseMessage.isValid()) {
+    if (response.isDeferred()) {
+        const uint token = mNextSyncReplyToken++;
+        mDeferredSyncReplies.insert(token);
+        QTimer::singleShot(MOZVIEW_SYNC_REPLY_TIMEOUT, this, [this, token, message]() {
+            if (mDeferredSyncReplies.remove(token)) {
+                qCWarning(lcEmbedLiteExt) << "Deferred reply to sync message" << message << "timed out";
+                QVariantMap reply;
+                reply.insert(QStringLiteral("token"), token);
+                reply.insert(QStringLiteral("error"), QStringLiteral("timeout"));
+                doSendAsyncMessage(QLatin1String(SYNC_MESSAGE_REPLY), reply);
+            }
+        });
+        QVariantMap deferred;
+        deferred.insert(QStringLiteral("deferred"), token);
+        responseDocument = QJsonDocument::fromVariant(deferred);
+    } else if (!responseMessage.isValid()) {
         // Default to an empty json
         responseDocument = QJsonDocument::fromJson("{\"\":\"\"}");
-    } else if (responseMessage.userType() == QMetaType::type("QJSValue")) {
-        // Qt 5.6 likes to pass a QJSValue
-        QJSValue jsValue = qvariant_cast<QJSValue>(responseMessage);
-        responseDocument = QJsonDocument::fromVariant(jsValue.toVariant());
     } else {
-        responseDocument = QJsonDocument::fromVariant(responseMessage);
+        responseDocument = toJsonDocument(responseMessage);
     }
-    QByteArray array = responseDocument.toJson();
+    QByteArray array = responseDocument.toJson(QJsonDocument::Compact);
     return strdup(array.constData());
 }
 
+QMozViewDiagnostics *QMozViewPrivate::diagnostics()
+{
+    return &mDiagnostics;
+}
+
+void QMozViewPrivate::replySyncMessage(uint token, const QVariant &message)
+{
+    if (QThread::currentThread() != thread()) {
+        QCoreApplication::postEvent(this, new QueuedCallEvent([this, token, message]() {
+            replySyncMessage(token, message);
+        }));
+        return;
+    }
+
+    if (!mDeferredSyncReplies.remove(token)) {
+        qCWarning(lcEmbedLiteExt) << "No deferred sync message for token" << token;
+        return;
+    }
+
+    QVariantMap reply;
+    reply.insert(QStringLiteral("token"), token);
+    reply.insert(QStringLiteral("message"), toJsonDocument(message).toVariant());
+    doSendAsyncMessage(QLatin1String(SYNC_MESSAGE_REPLY), reply);
+}
+
 void QMozViewPrivate::OnLoadRedirect(void)
 {
 #ifdef DEVELOPMENT_BUILD
@@ -1243,6 +1702,7 @@ void QMozViewPrivate::OnFirstPaint(int32_t aX, int32_t aY)
     qCInfo(lcEmbedLiteExt);
 #endif
     mIsPainted = true;
+    markStartup(StartupFirstPaint, "FirstPaint");
     mViewIface->firstPaint(aX, aY);
     if (mMozWindow) {
         if (mViewInitialized && mView) {
@@ -1272,10 +1732,15 @@ void QMozViewPrivate::OnScrolledAreaChanged(unsigned int aWidth, unsigned int aH
 
 void QMozViewPrivate::setIsFocused(bool aIsFocused)
 {
+    // A held back preedit belongs to the focused editor, deliver it before blur.
+    if (!aIsFocused) {
+        flushComposition();
+    }
     mViewIsFocused = aIsFocused;
     if (mViewInitialized) {
         mView->SetIsFocused(aIsFocused);
     }
+    QMozContextPrivate::instance()->scheduleViewTierUpdate();
 }
 
 void QMozViewPrivate::setDesktopMode(bool aDesktopMode)
@@ -1293,11 +1758,65 @@ void QMozViewPrivate::setDesktopMode(bool aDesktopMode)
 
 void QMozViewPrivate::setThrottlePainting(bool aThrottle)
 {
+    mThrottlePainting = aThrottle;
     if (mViewInitialized) {
-        mView->SetThrottlePainting(aThrottle);
+        mView->SetThrottlePainting(mThrottlePainting || sTierRefreshRate[policyTier()] == ThrottledRate);
+    }
+}
+
+// Timeouts are suspended while either the owner suspended the view or
+// the throttling policy put it into a background-old or frozen tier.
+void QMozViewPrivate::setTimeoutsSuspended(bool suspended)
+{
+    mTimeoutsSuspended = suspended;
+    if (!mViewInitialized) {
+        return;
+    }
+
+    const bool suspend = mTimeoutsSuspended || policyTier() >= QMozContext::BackgroundOldTier;
+    if (suspend != mGeckoTimeoutsSuspended) {
+        mGeckoTimeoutsSuspended = suspend;
+        if (suspend) {
+            mView->SuspendTimeouts();
+        } else {
+            mView->ResumeTimeouts();
+        }
     }
 }
 
+// Activating the view resets throttling of the refresh driver (PresShell::SetIsActive),
+// hence re-apply it after each SetIsActive call.
+void QMozViewPrivate::activeStateChanged()
+{
+    setThrottlePainting(mThrottlePainting);
+    QMozContextPrivate::instance()->scheduleViewTierUpdate();
+}
+
+void QMozViewPrivate::setTier(QMozContext::ViewTier tier)
+{
+    mTier = tier;
+    applyTier();
+}
+
+void QMozViewPrivate::applyTier()
+{
+    setThrottlePainting(mThrottlePainting);
+    setTimeoutsSuspended(mTimeoutsSuspended);
+}
+
+void QMozViewPrivate::markStartup(int phase, const char *name)
+{
+    if (!(mStartupMarks & phase) && mView) {
+        mStartupMarks |= phase;
+        QMozContextPrivate::markStartup(name, mView->GetUniqueID());
+    }
+}
+
+QMozContext::ViewTier QMozViewPrivate::policyTier() const
+{
+    return QMozContextPrivate::instance()->viewThrottling() ? mTier : QMozContext::ForegroundTier;
+}
+
 void QMozViewPrivate::IMENotification(int aIstate, bool aOpen, int aCause, int aFocusChange,
                                       const char16_t *inputType, const char16_t *inputMode)
 {
@@ -1325,6 +1844,10 @@ void QMozViewPrivate::IMENotification(int aIstate, bool aOpen, int aCause, int a
     }
 
     mViewIface->setInputMethodHints(hints);
+    if (aFocusChange) {
+        // A composition for the previous field must not reach the new one.
+        cancelComposition();
+    }
     if (aFocusChange || aIstate) {
         mIsInputFieldFocused = aIstate;
         if (mViewIsFocused) {
@@ -1396,7 +1919,11 @@ bool QMozViewPrivate::HandleLongTap(const nsIntPoint &aPoint)
 {
     QMozReturnValue retval;
     retval.setMessage(false);
+    QElapsedTimer handlerTimer;
+    handlerTimer.start();
     mViewIface->handleLongTap(QPoint(aPoint.x, aPoint.y), &retval);
+    mDiagnostics.record(QStringLiteral("handleLongTap"), QMozViewDiagnostics::BlockingMessage,
+                        handlerTimer.nsecsElapsed());
     return retval.getMessage().toBool();
 }
 
@@ -1404,7 +1931,11 @@ bool QMozViewPrivate::HandleSingleTap(const nsIntPoint &aPoint)
 {
     QMozReturnValue retval;
     retval.setMessage(false);
+    QElapsedTimer handlerTimer;
+    handlerTimer.start();
     mViewIface->handleSingleTap(QPoint(aPoint.x, aPoint.y), &retval);
+    mDiagnostics.record(QStringLiteral("handleSingleTap"), QMozViewDiagnostics::BlockingMessage,
+                        handlerTimer.nsecsElapsed());
     return retval.getMessage().toBool();
 }
 
@@ -1412,7 +1943,11 @@ bool QMozViewPrivate::HandleDoubleTap(const nsIntPoint &aPoint)
 {
     QMozReturnValue retval;
     retval.setMessage(false);
+    QElapsedTimer handlerTimer;
+    handlerTimer.start();
     mViewIface->handleDoubleTap(QPoint(aPoint.x, aPoint.y), &retval);
+    mDiagnostics.record(QStringLiteral("handleDoubleTap"), QMozViewDiagnostics::BlockingMessage,
+                        handlerTimer.nsecsElapsed());
     return retval.getMessage().toBool();
 }
 
@@ -1422,7 +1957,8 @@ void QMozViewPrivate::touchEvent(QTouchEvent *event)
     // be handled before this touch event. Problem is that
     // this also commits preedited text when moving web content.
     // This should be committed just before moving cursor position to
-    // the old cursor position.
+    // the old cursor position. A held back preedit goes first.
+    flushComposition();
     if (mPreedit) {
         QInputMethod *inputContext = qGuiApp->inputMethod();
         if (inputContext) {
@@ -1599,6 +2135,7 @@ void QMozViewPrivate::wheelEvent(QWheelEvent *event)
 void QMozViewPrivate::receiveInputEvent(const EmbedTouchInput &event)
 {
     if (mViewInitialized) {
+        flushComposition();
         mView->ReceiveInputEvent(event);
     }
 }
@@ -1654,6 +2191,7 @@ void QMozViewPrivate::synthTouchEnd(const QVariant &touches)
 void QMozViewPrivate::recvMouseMove(int posX, int posY)
 {
     if (mViewInitialized && mView && !mPendingTouchEvent) {
+        flushComposition();
         mView->MouseMove(posX, posY, QDateTime::currentMSecsSinceEpoch(), 0, 0);
     }
 }
@@ -1662,6 +2200,7 @@ void QMozViewPrivate::recvMousePress(int posX, int posY)
 {
     mViewIface->forceViewActiveFocus();
     if (mViewInitialized && mView && !mPendingTouchEvent) {
+        flushComposition();
         mView->MousePress(posX, posY, QDateTime::currentMSecsSinceEpoch(), 0, 0);
     }
 }
@@ -1669,6 +2208,7 @@ void QMozViewPrivate::recvMousePress(int posX, int posY)
 void QMozViewPrivate::recvMouseRelease(int posX, int posY)
 {
     if (mViewInitialized && mView && !mPendingTouchEvent) {
+        flushComposition();
         mView->MouseRelease(posX, posY, QDateTime::currentMSecsSinceEpoch(), 0, 0);
     }
 
@@ -1682,16 +2222,7 @@ void QMozViewPrivate::doSendAsyncMessage(const QString &message, const QVariant
     if (!mViewInitialized)
         return;
 
-    QJsonDocument doc;
-    if (value.userType() == QMetaType::type("QJSValue")) {
-        // Qt 5.6 likes to pass a QJSValue
-        QJSValue jsValue = qvariant_cast<QJSValue>(value);
-        doc = QJsonDocument::fromVariant(jsValue.toVariant());
-    } else {
-        doc = QJsonDocument::fromVariant(value);
-    }
-
-    QByteArray array = doc.toJson(QJsonDocument::Compact);
+    QByteArray array = toJsonDocument(value).toJson(QJsonDocument::Compact);
     QString data(array);
 
     mView->SendAsyncMessage((const char16_t *)message.utf16(), (const char16_t *)data.utf16());
@@ -1715,10 +2246,23 @@ bool QMozViewPrivate::handleAsyncMessage(const QString &message, const QVariant
     } else if (message == QLatin1String(RUN_JAVASCRIPT_REPLY)) {
         QVariantMap map = data.toMap();
         uint jsCallId = map.value(QLatin1String("callbackId")).toUInt();
-        QPair<QJSValue, QJSValue> callbacks = mPendingJSCalls.take(jsCallId);
         QVariant result = map.value(QLatin1String("result"));
         bool stringified = map.value(QLatin1String("stringified")).toBool();
         QVariant error = map.value(QLatin1String("error"));
+
+        JavaScriptCallback nativeCallback = mPendingNativeJSCalls.take(jsCallId);
+        if (nativeCallback) {
+            if (error.isValid()) {
+                nativeCallback(QVariant(), error.toString());
+            } else if (stringified) {
+                nativeCallback(QJsonDocument::fromJson(result.toString().toUtf8()).toVariant(), QString());
+            } else {
+                nativeCallback(result, QString());
+            }
+            return true;
+        }
+
+        QPair<QJSValue, QJSValue> callbacks = mPendingJSCalls.take(jsCallId);
         QJSValue callback = callbacks.first;
         if (error.isValid()) {
             QJSValue errorCallback = callbacks.second;
@@ -1760,18 +2304,21 @@ bool QMozViewPrivate::handleAsyncMessage(const QString &message, const QVariant
         return true;
     } else if (message == QLatin1String(INPUTMETHOD_SET_INPUT_CONTEXT)) {
         QVariantMap map = data.toMap();
-        mSurroundingText = map.value(QLatin1String("surroundingText"));
+        if (!updateSurroundingText(map)) {
+            requestInputContext();
+            return true;
+        }
         mCursorPosition = map.value(QLatin1String("cursorPosition"));
         mAnchorPosition = map.value(QLatin1String("anchorPosition"));
-        QInputMethod *inputContext = qGuiApp->inputMethod();
-        inputContext->update(Qt::ImSurroundingText | Qt::ImCursorPosition | Qt::ImAnchorPosition);
+        updateInputMethod(Qt::ImSurroundingText | Qt::ImCursorPosition | Qt::ImAnchorPosition);
         return true;
     } else if (message == QLatin1String(INPUTMETHOD_RESET_INPUT_CONTEXT)) {
         mSurroundingText = QVariant();
+        mSurroundingTextVersion = 0;
+        mInputContextRequested = false;
         mCursorPosition = QVariant();
         mAnchorPosition = QVariant();
-        QInputMethod *inputContext = qGuiApp->inputMethod();
-        inputContext->update(Qt::ImSurroundingText | Qt::ImCursorPosition | Qt::ImAnchorPosition);
+        updateInputMethod(Qt::ImSurroundingText | Qt::ImCursorPosition | Qt::ImAnchorPosition);
         return true;
     } else if (message == QLatin1String(INPUTMETHOD_SET_INPUT_ATTRIBUTES)) {
         QVariantMap map = data.toMap();
@@ -1796,6 +2343,55 @@ bool QMozViewPrivate::handleAsyncMessage(const QString &message, const QVariant
     return false;
 }
 
+/*
+ * An input context either carries the whole surrounding text window or an
+ * "edit" ({start, length, text}) to apply to the current one. Edits are
+ * numbered by "version" and must apply in sequence. Returns false when an
+ * edit cannot be applied and the full context is needed.
+ */
+bool QMozViewPrivate::updateSurroundingText(const QVariantMap &context)
+{
+    const QVariant version = context.value(QLatin1String("version"));
+    const QVariant edit = context.value(QLatin1String("edit"));
+    if (!edit.isValid()) {
+        mSurroundingText = context.value(QLatin1String("surroundingText"));
+        mSurroundingTextVersion = version.toUInt();
+        mInputContextRequested = false;
+        return true;
+    }
+
+    if (mInputContextRequested || !mSurroundingText.isValid()
+            || version.toUInt() != mSurroundingTextVersion + 1) {
+        return false;
+    }
+
+    const QVariantMap editMap = edit.toMap();
+    const int start = editMap.value(QLatin1String("start")).toInt();
+    const int length = editMap.value(QLatin1String("length")).toInt();
+    QString surroundingText = mSurroundingText.toString();
+    if (start < 0 || length < 0 || start + length > surroundingText.length()) {
+        return false;
+    }
+
+    surroundingText.replace(start, length, editMap.value(QLatin1String("text")).toString());
+    mSurroundingText = surroundingText;
+    mSurroundingTextVersion = version.toUInt();
+    return true;
+}
+
+void QMozViewPrivate::requestInputContext()
+{
+    if (mInputContextRequested) {
+        return;
+    }
+
+    qCDebug(lcEmbedLiteExt) << "Surrounding text out of sync at version" << mSurroundingTextVersion;
+    mInputContextRequested = true;
+    QVariantMap data;
+    data.insert(QStringLiteral("version"), mSurroundingTextVersion);
+    doSendAsyncMessage(QLatin1String(INPUTMETHOD_REQUEST_INPUT_CONTEXT), data);
+}
+
 void QMozViewPrivate::clearDirtyDynamicToolbarHeight()
 {
     if ((mDirtyState & DirtyDynamicToolbarHeight) && mViewInitialized && mDOMContentLoaded) {
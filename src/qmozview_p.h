@@ -22,16 +22,24 @@
 #include <QSGSimpleTextureNode>
 #include <QKeyEvent>
 #include <QJSValue>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QVariantMap>
+
+#include <functional>
 
 #ifndef Q_MOC_RUN
 #include <mozilla/embedlite/EmbedLiteView.h>
 #endif
 
+#include "qmozcontext.h"
 #include "qmozwindow.h"
 #include "qmozscrolldecorator.h"
 #include "qmozview_templated_wrapper.h"
 #include "qmozview_defined_wrapper.h"
 #include "qmozsecurity.h"
+#include "qmozviewdiagnostics.h"
 
 class QTouchEvent;
 class QMozContext;
@@ -64,6 +72,14 @@ public:
 
     Q_DECLARE_FLAGS(DirtyState, DirtyStateBit)
 
+    // Startup timeline phases recorded once per view.
+    enum StartupPhase {
+        StartupCreateView = 0x01,
+        StartupViewInitialized = 0x02,
+        StartupFirstPaint = 0x04,
+        StartupLoadFinished = 0x08,
+    };
+
     QMozViewPrivate(IMozQViewIface *aViewIface, QObject *publicPtr);
     virtual ~QMozViewPrivate();
 
@@ -100,6 +116,10 @@ public:
     void setIsFocused(bool aIsFocused);
     void setDesktopMode(bool aDesktopMode);
     void setThrottlePainting(bool aThrottle);
+    void setTimeoutsSuspended(bool suspended);
+    void activeStateChanged();
+    void setTier(QMozContext::ViewTier tier);
+    void applyTier();
     void updateScrollArea(unsigned int aWidth, unsigned int aHeight, float aPosX, float aPosY);
     void testFlickingMode(QTouchEvent *event);
     void handleTouchEnd(bool &draggingChanged, bool &pinchingChanged);
@@ -116,7 +136,11 @@ public:
     void runJavaScript(const QString &script,
                        const QJSValue &callback,
                        const QJSValue &errorCallback);
+    typedef QMozJavaScriptCallback JavaScriptCallback;
+    void runJavaScript(const QString &script, const JavaScriptCallback &callback);
     bool domContentLoaded() const;
+    void replySyncMessage(uint token, const QVariant &message);
+    QMozViewDiagnostics *diagnostics();
 
     void setSize(const QSizeF &size);
     void setScreenProperties(int depth, qreal dpi);
@@ -134,8 +158,15 @@ public:
 
     void startMoveMonitor();
     void timerEvent(QTimerEvent *event) override;
+    bool event(QEvent *event) override;
     QVariant inputMethodQuery(Qt::InputMethodQuery property) const;
     void inputMethodEvent(QInputMethodEvent *event);
+    void flushComposition();
+    void cancelComposition();
+    void scheduleInputCommit();
+    void updateInputMethod(Qt::InputMethodQueries queries);
+    bool updateSurroundingText(const QVariantMap &context);
+    void requestInputContext();
     void keyPressEvent(QKeyEvent *event);
     void keyReleaseEvent(QKeyEvent *event);
     void touchEvent(QTouchEvent *event);
@@ -158,6 +189,12 @@ public:
 
     void applyAutoCorrect();
 
+    bool discard();
+    void restore();
+
+Q_SIGNALS:
+    void discardedChanged();
+
 public Q_SLOTS:
     void onCompositorCreated();
     void updateLoaded();
@@ -166,6 +203,9 @@ public Q_SLOTS:
 protected:
     friend class QMozOpenGLWebPage;
     friend class QuickMozView;
+    friend class QMozContext;
+    friend class QMozContextPrivate;
+    friend class QMozViewPool;
 
     void synthTouchBegin(const QVariant &touches);
     void synthTouchMove(const QVariant &touches);
@@ -175,10 +215,14 @@ protected:
     void recvMouseRelease(int posX, int posY);
 
     void doSendAsyncMessage(const QString &message, const QVariant &value);
+    uint sendJavaScript(const QString &script, const JavaScriptCallback &callback);
     bool handleAsyncMessage(const QString &message, const QVariant &data);
     void clearDirtyDynamicToolbarHeight();
     qreal screenDensity() const;
     void sendScreenProperties();
+    QMozContext::ViewTier policyTier() const;
+    void finishDiscard(const QVariant &formData);
+    void markStartup(int phase, const char *name);
 
     IMozQViewIface *mViewIface;
     QPointer<QObject> q;
@@ -247,6 +291,15 @@ protected:
     QVariant mAnchorPosition;
     bool mIsInputFieldFocused;
     bool mPreedit;
+    // Coalesced preedit-only composition update.
+    bool mCompositionPending;
+    QString mPendingPreedit;
+    int mCompositionTimerId;
+    bool mInputCommitScheduled;
+    Qt::InputMethodQueries mPendingInputMethodQueries;
+    // Version of the last applied surrounding text edit.
+    uint mSurroundingTextVersion;
+    bool mInputContextRequested;
     bool mViewIsFocused;
     bool mPressed;
     bool mDragging;
@@ -257,14 +310,35 @@ protected:
     qreal mOffsetY;
     bool mHasCompositor;
     QMozSecurity mSecurity;
+    QMozViewDiagnostics mDiagnostics;
     int mDepth;
     qreal mDpi;
     // Pair of success and error callbacks.
     QMap<uint, QPair<QJSValue, QJSValue> > mPendingJSCalls;
+    QHash<uint, JavaScriptCallback> mPendingNativeJSCalls;
     uint mNextJSCallId;
+    // Deferred sync message replies by token, see replySyncMessage().
+    QSet<uint> mDeferredSyncReplies;
+    uint mNextSyncReplyToken;
     QString mHttpUserAgent;
     bool mAutoCompleteActive;
     QStringList mAutoCompleteList;
+    // Background throttling policy, see QMozContextPrivate::updateViewTiers()
+    QMozContext::ViewTier mTier;
+    qint64 mLastShownTime;
+    bool mThrottlePainting;
+    bool mTimeoutsSuspended;
+    bool mGeckoTimeoutsSuspended;
+    // Discarding, frame scripts and listeners are replayed to the recreated view.
+    QStringList mFrameScripts;
+    std::vector<std::string> mMessageListeners;
+    bool mDiscardable;
+    bool mDiscardPending;
+    bool mDiscarded;
+    QVariantMap mDiscardedState;
+    QImage mDiscardedThumbnail;
+    QElapsedTimer mCreationTimer;
+    int mStartupMarks;
 
     DirtyState mDirtyState;
 
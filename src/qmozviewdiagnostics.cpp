@@ -0,0 +1,91 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "qmozviewdiagnostics.h"
+#include "qmozembedlog.h"
+
+#include <QVariantList>
+
+#ifndef MOZVIEWDIAGNOSTICS_LATENCY_THRESHOLD
+#define MOZVIEWDIAGNOSTICS_LATENCY_THRESHOLD 50
+#endif
+
+QMozViewDiagnostics::QMozViewDiagnostics(QObject *parent)
+    : QObject(parent)
+    , mLatencyThreshold(MOZVIEWDIAGNOSTICS_LATENCY_THRESHOLD)
+{
+}
+
+int QMozViewDiagnostics::latencyThreshold() const
+{
+    return mLatencyThreshold;
+}
+
+// Zero disables reporting of slow handlers, statistics are kept regardless.
+void QMozViewDiagnostics::setLatencyThreshold(int milliseconds)
+{
+    milliseconds = qMax(0, milliseconds);
+    if (mLatencyThreshold != milliseconds) {
+        mLatencyThreshold = milliseconds;
+        Q_EMIT latencyThresholdChanged();
+    }
+}
+
+void QMozViewDiagnostics::record(const QString &name, MessageType type, qint64 nsecs)
+{
+    Latency &latency = mLatencies[name];
+    latency.type = type;
+    ++latency.count;
+    latency.total += nsecs;
+    latency.max = qMax(latency.max, nsecs);
+
+    int bucket = 0;
+    for (qint64 msecs = nsecs / 1000000; msecs > 0 && bucket < HistogramBuckets - 1; msecs >>= 1) {
+        ++bucket;
+    }
+    ++latency.histogram[bucket];
+
+    const qreal msecs = nsecs / 1000000.0;
+    if (mLatencyThreshold > 0 && msecs > mLatencyThreshold) {
+        qCWarning(lcEmbedLiteExt) << (type == BlockingMessage ? "Blocking" : "Async") << "handler of"
+                                  << name << "took" << msecs << "ms";
+        Q_EMIT slowMessage(name, type, msecs);
+    }
+}
+
+/*!
+    \fn QVariantMap QMozViewDiagnostics::messageLatencies() const
+
+    Returns the statistics of every handled message name as a map with
+    "blocking", "count", "mean" and "max" (milliseconds) and "histogram",
+    a list of counts for under 1 ms, under 2 ms, under 4 ms and so on,
+    the last bucket counting everything from 1024 ms up.
+*/
+QVariantMap QMozViewDiagnostics::messageLatencies() const
+{
+    QVariantMap latencies;
+    for (auto it = mLatencies.constBegin(); it != mLatencies.constEnd(); ++it) {
+        const Latency &latency = it.value();
+        QVariantList histogram;
+        for (int count : latency.histogram) {
+            histogram.append(count);
+        }
+
+        QVariantMap entry;
+        entry.insert(QStringLiteral("blocking"), latency.type == BlockingMessage);
+        entry.insert(QStringLiteral("count"), latency.count);
+        entry.insert(QStringLiteral("mean"), latency.total / 1000000.0 / latency.count);
+        entry.insert(QStringLiteral("max"), latency.max / 1000000.0);
+        entry.insert(QStringLiteral("histogram"), histogram);
+        latencies.insert(it.key(), entry);
+    }
+    return latencies;
+}
+
+void QMozViewDiagnostics::reset()
+{
+    mLatencies.clear();
+}
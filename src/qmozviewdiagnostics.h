@@ -0,0 +1,65 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef QMOZVIEWDIAGNOSTICS_H
+#define QMOZVIEWDIAGNOSTICS_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+#include <QVariantMap>
+
+/*
+ * Latency statistics of the message handlers of a view, keyed by message
+ * name. Blocking handlers (sync messages and tap handlers) stall the
+ * content side for their whole duration, async ones only the UI thread.
+ * Handlers slower than latencyThreshold are logged and reported through
+ * slowMessage().
+ */
+class QMozViewDiagnostics : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int latencyThreshold READ latencyThreshold WRITE setLatencyThreshold NOTIFY latencyThresholdChanged FINAL)
+
+public:
+    enum MessageType {
+        BlockingMessage,
+        AsyncMessage
+    };
+    Q_ENUM(MessageType)
+
+    explicit QMozViewDiagnostics(QObject *parent = nullptr);
+
+    int latencyThreshold() const;
+    void setLatencyThreshold(int milliseconds);
+
+    void record(const QString &name, MessageType type, qint64 nsecs);
+
+    Q_INVOKABLE QVariantMap messageLatencies() const;
+    Q_INVOKABLE void reset();
+
+Q_SIGNALS:
+    void latencyThresholdChanged();
+    void slowMessage(const QString &name, MessageType type, qreal milliseconds);
+
+private:
+    // Bucket 0 counts handlers under 1 ms, bucket i > 0 those under 2^i ms
+    // and the last one everything slower.
+    static const int HistogramBuckets = 12;
+
+    struct Latency {
+        MessageType type = AsyncMessage;
+        int count = 0;
+        qint64 total = 0;
+        qint64 max = 0;
+        int histogram[HistogramBuckets] = {};
+    };
+
+    QHash<QString, Latency> mLatencies;
+    int mLatencyThreshold;
+};
+
+#endif // QMOZVIEWDIAGNOSTICS_H
@@ -0,0 +1,234 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "qmozviewpool_p.h"
+#include "qmozcontext_p.h"
+#include "qmozview_p.h"
+#include "qmozwindow_p.h"
+
+#include "mozilla/embedlite/EmbedLiteApp.h"
+#include "mozilla/embedlite/EmbedLiteView.h"
+
+using namespace mozilla::embedlite;
+
+// Delay before the pool is refilled after a view was taken or loading ended.
+#ifndef MOZVIEWPOOL_REFILL_DELAY
+#define MOZVIEWPOOL_REFILL_DELAY 1000
+#endif
+
+#ifndef MOZVIEWPOOL_MAX_SIZE
+#define MOZVIEWPOOL_MAX_SIZE 4
+#endif
+
+class QMozViewPool::Entry : public EmbedLiteViewListener
+{
+public:
+    Entry(QMozViewPool *pool, EmbedLiteView *view, bool privateMode)
+        : pool(pool)
+        , view(view)
+        , privateMode(privateMode)
+        , initialized(false)
+    {
+        view->SetListener(this);
+    }
+
+    void ViewInitialized() override
+    {
+        initialized = true;
+        pool->entryInitialized(this);
+    }
+
+    void ViewDestroyed() override
+    {
+        view = nullptr;
+        pool->entryDestroyed(this);
+    }
+
+    QMozViewPool *pool;
+    EmbedLiteView *view;
+    bool privateMode;
+    bool initialized;
+};
+
+QMozViewPool::QMozViewPool(QObject *parent)
+    : QObject(parent)
+    , mHits(0)
+    , mMisses(0)
+    , mCreations(0)
+    , mCreationTimeTotal(0)
+    , mLastCreationTime(0)
+{
+    mSize[0] = 0;
+    mSize[1] = 0;
+    mRefillTimer.setSingleShot(true);
+    mRefillTimer.setInterval(MOZVIEWPOOL_REFILL_DELAY);
+    connect(&mRefillTimer, &QTimer::timeout, this, &QMozViewPool::refill);
+}
+
+QMozViewPool::~QMozViewPool()
+{
+    clear();
+}
+
+int QMozViewPool::size(bool privateMode) const
+{
+    return mSize[privateMode];
+}
+
+void QMozViewPool::setSize(bool privateMode, int size)
+{
+    size = qBound(0, size, MOZVIEWPOOL_MAX_SIZE);
+    if (mSize[privateMode] == size) {
+        return;
+    }
+
+    mSize[privateMode] = size;
+
+    QMozContextPrivate *context = QMozContextPrivate::instance();
+    for (int i = mEntries.count() - 1; i >= 0 && available(privateMode) > size; --i) {
+        Entry *entry = mEntries.at(i);
+        if (entry->privateMode == privateMode && entry->view) {
+            mEntries.removeAt(i);
+            entry->view->SetListener(nullptr);
+            context->mApp->DestroyView(entry->view);
+            delete entry;
+        }
+    }
+    scheduleRefill();
+}
+
+EmbedLiteView *QMozViewPool::take(QMozWindow *window, bool privateMode)
+{
+    if (mSize[privateMode] == 0) {
+        return nullptr;
+    }
+
+    scheduleRefill();
+    for (int i = 0; i < mEntries.count(); ++i) {
+        Entry *entry = mEntries.at(i);
+        if (entry->initialized && entry->privateMode == privateMode && window == mWindow) {
+            EmbedLiteView *view = entry->view;
+            mEntries.removeAt(i);
+            delete entry;
+            view->SetListener(nullptr);
+            ++mHits;
+            Q_EMIT statsChanged();
+            return view;
+        }
+    }
+
+    ++mMisses;
+    Q_EMIT statsChanged();
+    return nullptr;
+}
+
+// Time from view creation request to ViewInitialized, pool hits included.
+void QMozViewPool::recordCreation(qint64 msecs)
+{
+    ++mCreations;
+    mCreationTimeTotal += msecs;
+    mLastCreationTime = msecs;
+    Q_EMIT statsChanged();
+}
+
+QVariantMap QMozViewPool::stats() const
+{
+    QVariantMap stats;
+    stats.insert(QStringLiteral("hits"), mHits);
+    stats.insert(QStringLiteral("misses"), mMisses);
+    stats.insert(QStringLiteral("available"), available(false));
+    stats.insert(QStringLiteral("availablePrivate"), available(true));
+    stats.insert(QStringLiteral("lastCreationTime"), mLastCreationTime);
+    stats.insert(QStringLiteral("averageCreationTime"),
+                 mCreations > 0 ? qreal(mCreationTimeTotal) / mCreations : 0.0);
+    return stats;
+}
+
+void QMozViewPool::clear()
+{
+    mRefillTimer.stop();
+    if (mEntries.isEmpty()) {
+        return;
+    }
+
+    QMozContextPrivate *context = QMozContextPrivate::instance();
+    for (Entry *entry : mEntries) {
+        if (entry->view && context) {
+            entry->view->SetListener(nullptr);
+            context->mApp->DestroyView(entry->view);
+        }
+        delete entry;
+    }
+    mEntries.clear();
+    mWindow = nullptr;
+    Q_EMIT statsChanged();
+}
+
+void QMozViewPool::scheduleRefill()
+{
+    if ((mSize[0] > 0 || mSize[1] > 0) && !mRefillTimer.isActive()) {
+        mRefillTimer.start();
+    }
+}
+
+void QMozViewPool::refill()
+{
+    QMozContextPrivate *context = QMozContextPrivate::instance();
+    if (!context->IsInitialized() || !context->mMozWindow) {
+        return;
+    }
+
+    if (mWindow != context->mMozWindow) {
+        clear();
+        mWindow = context->mMozWindow;
+    }
+
+    // Create one view at a time and only while nothing is loading.
+    for (const Entry *entry : mEntries) {
+        if (!entry->initialized) {
+            return;
+        }
+    }
+    for (const QMozViewPrivate *view : context->mViews) {
+        if (view->mIsLoading) {
+            scheduleRefill();
+            return;
+        }
+    }
+
+    for (bool privateMode : { false, true }) {
+        if (available(privateMode) < mSize[privateMode]) {
+            EmbedLiteView *view = context->mApp->CreateView(mWindow->d->mWindow, 0, 0,
+                                                            privateMode, false, false);
+            mEntries.append(new Entry(this, view, privateMode));
+            return;
+        }
+    }
+}
+
+void QMozViewPool::entryInitialized(Entry *entry)
+{
+    entry->view->SetIsActive(false);
+    scheduleRefill();
+    Q_EMIT statsChanged();
+}
+
+void QMozViewPool::entryDestroyed(Entry *entry)
+{
+    mEntries.removeOne(entry);
+    delete entry;
+    Q_EMIT statsChanged();
+}
+
+int QMozViewPool::available(bool privateMode) const
+{
+    int count = 0;
+    for (const Entry *entry : mEntries) {
+        if (entry->privateMode == privateMode) {
+            ++count;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,76 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-*/
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef QMOZVIEWPOOL_P_H
+#define QMOZVIEWPOOL_P_H
+
+#include <QObject>
+#include <QList>
+#include <QPointer>
+#include <QTimer>
+#include <QVariantMap>
+
+#include "qmozwindow.h"
+
+namespace mozilla {
+namespace embedlite {
+class EmbedLiteView;
+}
+}
+
+/*
+ * Pool of initialized, inactive views created ahead of time so that new
+ * tabs and popups without an opener do not wait for view initialization.
+ * Separate pools are kept for normal and private browsing. Pooled views are
+ * created in mobile mode, desktop mode views are never taken from the pool. Views are bound
+ * to the registered QMozWindow and refilled one at a time while no view
+ * is loading.
+ */
+class QMozViewPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QMozViewPool(QObject *parent = 0);
+    ~QMozViewPool();
+
+    int size(bool privateMode) const;
+    void setSize(bool privateMode, int size);
+
+    // Returns an initialized view for window or nullptr on a pool miss.
+    // The caller takes over the view and must set its listener.
+    mozilla::embedlite::EmbedLiteView *take(QMozWindow *window, bool privateMode);
+    void recordCreation(qint64 msecs);
+    QVariantMap stats() const;
+
+    void clear();
+    void scheduleRefill();
+
+Q_SIGNALS:
+    void statsChanged();
+
+private Q_SLOTS:
+    void refill();
+
+private:
+    class Entry;
+    friend class Entry;
+
+    void entryInitialized(Entry *entry);
+    void entryDestroyed(Entry *entry);
+    int available(bool privateMode) const;
+
+    QList<Entry *> mEntries;
+    QPointer<QMozWindow> mWindow;
+    int mSize[2];
+    QTimer mRefillTimer;
+    int mHits;
+    int mMisses;
+    int mCreations;
+    qint64 mCreationTimeTotal;
+    qint64 mLastCreationTime;
+};
+
+#endif // QMOZVIEWPOOL_P_H
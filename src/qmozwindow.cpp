@@ -87,6 +87,12 @@ Qt::ScreenOrientation QMozWindow::primaryOrientation() const
     return d->mPrimaryOrientation;
 }
 
+// Can be called from any thread.
+Qt::ScreenOrientation QMozWindow::compositedOrientation() const
+{
+    return static_cast<Qt::ScreenOrientation>(d->mCompositedOrientation.load());
+}
+
 void QMozWindow::getPlatformImage(const std::function<void(void *image, int width, int height)> &callback)
 {
     d->mWindow->GetPlatformImage(callback);
@@ -119,7 +125,7 @@ bool QMozWindow::setReadyToPaint(bool ready)
 
 bool QMozWindow::readyToPaint() const
 {
-    return d->PreRender();
+    return d->readyToPaint();
 }
 
 bool QMozWindow::isCompositorCreated()
@@ -127,6 +133,102 @@ bool QMozWindow::isCompositorCreated()
     return d->mCompositorCreated;
 }
 
+/*!
+    \fn bool QMozWindow::startFrameCapture(const std::function<void(const QMozWindowFrame &frame)> &callback, int bufferCount)
+
+    Starts copying every composited frame into a ring of \a bufferCount reusable
+    buffers. The \a callback is called on the compositor thread for each frame and
+    must return quickly, typically by handing the frame over to an encoder. The
+    buffer of a frame is reused only after releaseFrame() has been called for it,
+    frames are dropped while all buffers are held. Frames must not be accessed after
+    stopFrameCapture().
+*/
+bool QMozWindow::startFrameCapture(const std::function<void(const QMozWindowFrame &frame)> &callback, int bufferCount)
+{
+    return d->startFrameCapture(callback, bufferCount);
+}
+
+void QMozWindow::stopFrameCapture()
+{
+    d->stopFrameCapture();
+}
+
+bool QMozWindow::isCapturingFrames() const
+{
+    return d->mCapturing.load();
+}
+
+// Can be called from any thread.
+void QMozWindow::releaseFrame(const QMozWindowFrame &frame)
+{
+    d->releaseFrame(frame);
+}
+
+int QMozWindow::droppedFrames() const
+{
+    return d->mDroppedFrames.load();
+}
+
+// Composites during the last second.
+qreal QMozWindow::fps() const
+{
+    return d->fps();
+}
+
+// Composites that took longer than a vsync or were presented late.
+int QMozWindow::jankFrames() const
+{
+    return d->mJankFrames.load();
+}
+
+int QMozWindow::missedVsyncs() const
+{
+    return d->mMissedVsyncs.load();
+}
+
+// Percentiles of the interval between composites in milliseconds, idle periods excluded.
+qreal QMozWindow::frameTimeP50() const
+{
+    return d->frameTimePercentile(50);
+}
+
+qreal QMozWindow::frameTimeP95() const
+{
+    return d->frameTimePercentile(95);
+}
+
+qreal QMozWindow::frameTimeP99() const
+{
+    return d->frameTimePercentile(99);
+}
+
+// Percentile of the composite duration in milliseconds.
+qreal QMozWindow::compositeTimeP95() const
+{
+    return d->compositeTimePercentile(95);
+}
+
+void QMozWindow::resetFrameStats()
+{
+    d->resetFrameStats();
+    Q_EMIT frameStatsChanged();
+}
+
+/*!
+    \fn QByteArray QMozWindow::frameTrace() const
+
+    Returns the recent composites in Chrome trace event JSON format.
+*/
+QByteArray QMozWindow::frameTrace() const
+{
+    return d->frameTrace();
+}
+
+void QMozWindow::notifyFrameStats()
+{
+    d->notifyFrameStats();
+}
+
 void QMozWindow::timerEvent(QTimerEvent *event)
 {
     d->timerEvent(event);
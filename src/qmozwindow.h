@@ -16,9 +16,33 @@
 
 class QMozWindowPrivate;
 
+// A composited frame in the capture ring of a QMozWindow. Pixels are
+// tightly packed RGBA rows, bottom row first, in the primary orientation.
+struct QMozWindowFrame
+{
+    const uchar *data;
+    QSize size;
+    int bytesPerLine;
+    // memfd backing the whole ring and the offset of this frame in it,
+    // fd is -1 if the ring could not be shared.
+    int fd;
+    qint64 offset;
+    // CLOCK_MONOTONIC time of the end of compositing in microseconds.
+    qint64 timestamp;
+    quint64 sequence;
+    int slot;
+};
+
 class QMozWindow: public QObject
 {
     Q_OBJECT
+    Q_PROPERTY(qreal fps READ fps NOTIFY frameStatsChanged)
+    Q_PROPERTY(int jankFrames READ jankFrames NOTIFY frameStatsChanged)
+    Q_PROPERTY(int missedVsyncs READ missedVsyncs NOTIFY frameStatsChanged)
+    Q_PROPERTY(qreal frameTimeP50 READ frameTimeP50 NOTIFY frameStatsChanged)
+    Q_PROPERTY(qreal frameTimeP95 READ frameTimeP95 NOTIFY frameStatsChanged)
+    Q_PROPERTY(qreal frameTimeP99 READ frameTimeP99 NOTIFY frameStatsChanged)
+    Q_PROPERTY(qreal compositeTimeP95 READ compositeTimeP95 NOTIFY frameStatsChanged)
 
 public:
     explicit QMozWindow(const QSize &size, QObject *parent = nullptr);
@@ -34,6 +58,7 @@ public:
     Qt::ScreenOrientation contentOrientation() const;
     Qt::ScreenOrientation pendingOrientation() const;
     Qt::ScreenOrientation primaryOrientation() const;
+    Qt::ScreenOrientation compositedOrientation() const;
     void getPlatformImage(const std::function<void(void *image, int width, int height)> &callback);
     void clearPlatformImage();
     void suspendRendering();
@@ -44,6 +69,22 @@ public:
 
     bool isCompositorCreated();
 
+    bool startFrameCapture(const std::function<void(const QMozWindowFrame &frame)> &callback, int bufferCount = 3);
+    void stopFrameCapture();
+    bool isCapturingFrames() const;
+    void releaseFrame(const QMozWindowFrame &frame);
+    int droppedFrames() const;
+
+    qreal fps() const;
+    int jankFrames() const;
+    int missedVsyncs() const;
+    qreal frameTimeP50() const;
+    qreal frameTimeP95() const;
+    qreal frameTimeP99() const;
+    qreal compositeTimeP95() const;
+    Q_INVOKABLE void resetFrameStats();
+    Q_INVOKABLE QByteArray frameTrace() const;
+
 Q_SIGNALS:
     void pendingOrientationChanged(Qt::ScreenOrientation orientation);
     void orientationChangeFiltered(Qt::ScreenOrientation orientation);
@@ -55,13 +96,18 @@ Q_SIGNALS:
     void drawOverlay(QRect);
     void compositorCreated();
     void compositingFinished();
+    void frameStatsChanged();
 
 protected:
     void timerEvent(QTimerEvent *event);
 
+private Q_SLOTS:
+    void notifyFrameStats();
+
 private:
     friend class QMozViewPrivate;
     friend class QMozWindowPrivate;
+    friend class QMozViewPool;
 
     QScopedPointer<QMozWindowPrivate> d;
 
@@ -12,15 +12,53 @@
 
 #include "qmozwindow.h"
 
+#include <QCoreApplication>
 #include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#if defined(QT_OPENGL_ES_2)
+#include <QOpenGLFunctions_ES2>
+#else
+#include <QOpenGLFunctions>
+#endif
 #include <QScreen>
+#include <QThread>
 
 #include <mozilla/embedlite/EmbedLiteWindow.h>
 
+#include <algorithm>
+#include <atomic>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Composite intervals longer than this are idle periods rather than jank.
+#ifndef MOZWINDOW_FRAME_IDLE_THRESHOLD
+#define MOZWINDOW_FRAME_IDLE_THRESHOLD 100
+#endif
+
+// Minimum interval between frameStatsChanged notifications.
+#ifndef MOZWINDOW_FRAME_STATS_INTERVAL
+#define MOZWINDOW_FRAME_STATS_INTERVAL 500
+#endif
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
 #ifndef MOZWINDOW_ORIENTATION_CHANGE_TIMEOUT
 #define MOZWINDOW_ORIENTATION_CHANGE_TIMEOUT 500
 #endif
 
+// Debounce of an isolated orientation change. Changes following each other
+// within MOZWINDOW_ORIENTATION_CHANGE_TIMEOUT wait for the full timeout.
+#ifndef MOZWINDOW_ORIENTATION_SETTLE_TIMEOUT
+#define MOZWINDOW_ORIENTATION_SETTLE_TIMEOUT 50
+#endif
+
 namespace {
 
 mozilla::embedlite::ScreenRotation QtToMozillaRotation(int rotation)
@@ -44,24 +82,93 @@ mozilla::embedlite::ScreenRotation QtToMozillaRotation(int rotation)
     }
 }
 
+// Non zero tag marking a capture slot as held by the frame with the sequence.
+int frameTag(quint64 sequence)
+{
+    return int(sequence % 0x7fffffff) + 1;
+}
+
+qreal percentileOf(QVector<qint64> values, qreal percentile)
+{
+    if (values.isEmpty()) {
+        return 0;
+    }
+    const int index = qBound(0, int(percentile / 100 * (values.count() - 1) + 0.5), values.count() - 1);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values.at(index) / 1000.0;
+}
+
 } // namespace
 
+qint64 QMozWindowPrivate::monotonicMicroseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return qint64(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
 QMozWindowPrivate::QMozWindowPrivate(QMozWindow &window, const QSize &size)
     : q(window)
     , mWindow(nullptr)
     , mCompositorCreated(false)
-    , mReadyToPaint(true)
     , mSize(size)
     , mOrientation(Qt::PrimaryOrientation)
     , mPrimaryOrientation(qApp->primaryScreen()->primaryOrientation())
     , mPendingOrientation(Qt::PrimaryOrientation)
     , mOrientationFilterTimer(0)
     , mReserved(false)
+    , mCompositedOrientation(Qt::PrimaryOrientation)
+    , mCaptureMemory(nullptr)
+    , mCaptureMemorySize(0)
+    , mCaptureFd(-1)
+    , mCaptureBufferCount(0)
+    , mCaptureSequence(0)
+    , mCompositeStart(0)
+    , mCompositeOverlay(0)
+    , mLastCompositeEnd(0)
+    , mVsyncInterval(1000000 / 60)
+    , mFrameStatsTimer(0)
+    , mFrameStatsNotifiedCount(0)
 {
+    mCompositorState.size = mSize;
+    mCompositorState.orientation = mOrientation;
+    mCompositorState.primaryOrientation = mPrimaryOrientation;
+
+    const qreal refreshRate = qApp->primaryScreen()->refreshRate();
+    if (refreshRate > 0) {
+        mVsyncInterval = qint64(1000000 / refreshRate);
+    }
 }
 
 QMozWindowPrivate::~QMozWindowPrivate()
 {
+    stopFrameCapture();
+}
+
+template <typename Update>
+void QMozWindowPrivate::updateCompositorState(Update update)
+{
+    QMutexLocker lock(&mCompositorStateWriteMutex);
+    mCompositorStateSequence.fetchAndAddOrdered(1);
+    update(mCompositorState);
+    mCompositorStateSequence.fetchAndAddOrdered(1);
+}
+
+// Can be called from any thread, returns a consistent snapshot without blocking on writers.
+QMozWindowPrivate::CompositorState QMozWindowPrivate::compositorState() const
+{
+    for (;;) {
+        const int sequence = mCompositorStateSequence.loadAcquire();
+        if (sequence & 1) {
+            QThread::yieldCurrentThread();
+            continue;
+        }
+        const CompositorState state = mCompositorState;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (mCompositorStateSequence.load() == sequence) {
+            return state;
+        }
+    }
 }
 
 void QMozWindowPrivate::setSize(const QSize &size)
@@ -70,34 +177,63 @@ void QMozWindowPrivate::setSize(const QSize &size)
         qCDebug(lcEmbedLiteExt) << "Trying to set empty size: " << size;
     } else if (size != mSize) {
         mSize = size;
+        updateCompositorState([&size](CompositorState &state) {
+            state.size = size;
+        });
         mWindow->SetSize(size.width(), size.height());
     }
 }
 
 void QMozWindowPrivate::setContentOrientation(Qt::ScreenOrientation orientation)
 {
+    if (mPendingOrientation == orientation) {
+        // Repeated requests, e.g. from polishing, must not hold the change back.
+        if (mOrientationFilterTimer == 0) {
+            mOrientationFilterTimer = q.startTimer(MOZWINDOW_ORIENTATION_SETTLE_TIMEOUT);
+        }
+        return;
+    }
+
     if (mOrientationFilterTimer > 0) {
         q.killTimer(mOrientationFilterTimer);
         mOrientationFilterTimer = 0;
     }
 
-    if (mPendingOrientation != orientation) {
-        mPendingOrientation = orientation;
-        q.pendingOrientationChanged(mPendingOrientation);
-    }
-    mOrientationFilterTimer = q.startTimer(MOZWINDOW_ORIENTATION_CHANGE_TIMEOUT);
+    // An isolated change is a deliberate rotation and is committed almost
+    // immediately. Rapid successive changes mean the device is still being
+    // turned, in which case wait until it has been stable for a while.
+    const bool settling = mOrientationChangeTime.isValid()
+            && mOrientationChangeTime.elapsed() < MOZWINDOW_ORIENTATION_CHANGE_TIMEOUT;
+    mOrientationChangeTime.start();
+
+    mPendingOrientation = orientation;
+    q.pendingOrientationChanged(mPendingOrientation);
+    mOrientationFilterTimer = q.startTimer(settling ? MOZWINDOW_ORIENTATION_CHANGE_TIMEOUT
+                                                    : MOZWINDOW_ORIENTATION_SETTLE_TIMEOUT);
 }
 
 void QMozWindowPrivate::setPrimaryOrientation(Qt::ScreenOrientation orientation)
 {
     if (mPrimaryOrientation != orientation) {
         mPrimaryOrientation = orientation;
+        updateCompositorState([orientation](CompositorState &state) {
+            state.primaryOrientation = orientation;
+        });
     }
 }
 
 void QMozWindowPrivate::timerEvent(QTimerEvent *event)
 {
-    if (event->timerId() == mOrientationFilterTimer) {
+    if (event->timerId() == mFrameStatsTimer) {
+        q.killTimer(mFrameStatsTimer);
+        mFrameStatsTimer = 0;
+        mFrameStatsPending.store(0);
+        // Frames that arrived while throttled did not request a notification.
+        if (mFrameCount.load() != mFrameStatsNotifiedCount && mFrameStatsPending.testAndSetOrdered(0, 1)) {
+            notifyFrameStats();
+        }
+        event->accept();
+    } else if (event->timerId() == mOrientationFilterTimer) {
         q.killTimer(mOrientationFilterTimer);
         mOrientationFilterTimer = 0;
         if (mWindow) {
@@ -105,6 +241,10 @@ void QMozWindowPrivate::timerEvent(QTimerEvent *event)
                 int rotation = QGuiApplication::primaryScreen()->angleBetween(mPendingOrientation, mPrimaryOrientation);
                 mWindow->SetContentOrientation(QtToMozillaRotation(rotation));
                 mOrientation = mPendingOrientation;
+                const Qt::ScreenOrientation orientation = mOrientation;
+                updateCompositorState([orientation](CompositorState &state) {
+                    state.orientation = orientation;
+                });
             } else {
                 q.orientationChangeFiltered(mOrientation);
             }
@@ -113,14 +253,315 @@ void QMozWindowPrivate::timerEvent(QTimerEvent *event)
     }
 }
 
+QVector<QMozWindowPrivate::FrameTiming> QMozWindowPrivate::frameHistory() const
+{
+    const int count = mFrameCount.loadAcquire();
+    const int available = qMin(count, MOZWINDOW_FRAME_HISTORY);
+
+    QVector<FrameTiming> history;
+    history.reserve(available);
+    for (int i = count - available; i < count; ++i) {
+        const FrameTimingSlot &slot = mFrameHistory[uint(i) % MOZWINDOW_FRAME_HISTORY];
+        for (int attempt = 0; attempt < 3; ++attempt) {
+            const int sequence = slot.sequence.loadAcquire();
+            if (sequence & 1) {
+                continue;
+            }
+            const FrameTiming timing = slot.timing;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load() == sequence) {
+                history.append(timing);
+                break;
+            }
+        }
+    }
+    return history;
+}
+
+qreal QMozWindowPrivate::fps() const
+{
+    const qint64 since = monotonicMicroseconds() - 1000000;
+    int frames = 0;
+    for (const FrameTiming &timing : frameHistory()) {
+        if (timing.end >= since) {
+            ++frames;
+        }
+    }
+    return frames;
+}
+
+qreal QMozWindowPrivate::frameTimePercentile(qreal percentile) const
+{
+    const QVector<FrameTiming> history = frameHistory();
+    QVector<qint64> intervals;
+    intervals.reserve(history.count());
+    for (int i = 1; i < history.count(); ++i) {
+        const qint64 interval = history.at(i).end - history.at(i - 1).end;
+        if (interval < MOZWINDOW_FRAME_IDLE_THRESHOLD * 1000) {
+            intervals.append(interval);
+        }
+    }
+    return percentileOf(intervals, percentile);
+}
+
+qreal QMozWindowPrivate::compositeTimePercentile(qreal percentile) const
+{
+    const QVector<FrameTiming> history = frameHistory();
+    QVector<qint64> durations;
+    durations.reserve(history.count());
+    for (const FrameTiming &timing : history) {
+        durations.append(timing.end - timing.start);
+    }
+    return percentileOf(durations, percentile);
+}
+
+// Chrome trace event format, loadable in about:tracing and Perfetto.
+QByteArray QMozWindowPrivate::frameTrace() const
+{
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray events;
+    for (const FrameTiming &timing : frameHistory()) {
+        QJsonObject composite;
+        composite.insert(QStringLiteral("name"), QStringLiteral("Composite"));
+        composite.insert(QStringLiteral("ph"), QStringLiteral("X"));
+        composite.insert(QStringLiteral("ts"), double(timing.start));
+        composite.insert(QStringLiteral("dur"), double(timing.end - timing.start));
+        composite.insert(QStringLiteral("pid"), double(pid));
+        composite.insert(QStringLiteral("tid"), 0);
+        events.append(composite);
+
+        if (timing.overlay) {
+            QJsonObject overlay;
+            overlay.insert(QStringLiteral("name"), QStringLiteral("DrawOverlay"));
+            overlay.insert(QStringLiteral("ph"), QStringLiteral("i"));
+            overlay.insert(QStringLiteral("s"), QStringLiteral("t"));
+            overlay.insert(QStringLiteral("ts"), double(timing.overlay));
+            overlay.insert(QStringLiteral("pid"), double(pid));
+            overlay.insert(QStringLiteral("tid"), 0);
+            events.append(overlay);
+        }
+    }
+
+    QJsonObject trace;
+    trace.insert(QStringLiteral("traceEvents"), events);
+    trace.insert(QStringLiteral("displayTimeUnit"), QStringLiteral("ms"));
+    return QJsonDocument(trace).toJson(QJsonDocument::Compact);
+}
+
+void QMozWindowPrivate::resetFrameStats()
+{
+    mJankFrames.store(0);
+    mMissedVsyncs.store(0);
+}
+
+void QMozWindowPrivate::notifyFrameStats()
+{
+    mFrameStatsNotifiedCount = mFrameCount.load();
+    q.frameStatsChanged();
+    if (!mFrameStatsTimer) {
+        mFrameStatsTimer = q.startTimer(MOZWINDOW_FRAME_STATS_INTERVAL);
+    }
+}
+
+// Runs on the compositor thread.
+void QMozWindowPrivate::recordFrame(qint64 end)
+{
+    const qint64 start = mCompositeStart ? mCompositeStart : end;
+    const qint64 interval = mLastCompositeEnd ? end - mLastCompositeEnd : 0;
+
+    FrameTimingSlot &slot = mFrameHistory[uint(mFrameCount.load()) % MOZWINDOW_FRAME_HISTORY];
+    slot.sequence.fetchAndAddOrdered(1);
+    slot.timing.start = start;
+    slot.timing.overlay = mCompositeOverlay;
+    slot.timing.end = end;
+    slot.sequence.fetchAndAddOrdered(1);
+    mFrameCount.fetchAndAddOrdered(1);
+
+    // A composite is janky if it took longer than a vsync or if it was
+    // presented one or more vsyncs late while content kept changing.
+    bool jank = end - start > mVsyncInterval;
+    if (interval > mVsyncInterval * 3 / 2 && interval < MOZWINDOW_FRAME_IDLE_THRESHOLD * 1000) {
+        mMissedVsyncs.fetchAndAddRelaxed(int((interval + mVsyncInterval / 2) / mVsyncInterval) - 1);
+        jank = true;
+    }
+    if (jank) {
+        mJankFrames.ref();
+    }
+
+    mLastCompositeEnd = end;
+    mCompositeStart = 0;
+    mCompositeOverlay = 0;
+
+    if (mFrameStatsPending.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(&q, "notifyFrameStats", Qt::QueuedConnection);
+    }
+}
+
 bool QMozWindowPrivate::setReadyToPaint(bool ready)
 {
-    QMutexLocker lock(&mReadyToPaintMutex);
-    if (mReadyToPaint != ready) {
-        mReadyToPaint = ready;
-        return true;
+    bool changed = false;
+    updateCompositorState([ready, &changed](CompositorState &state) {
+        changed = state.readyToPaint != ready;
+        state.readyToPaint = ready;
+    });
+    return changed;
+}
+
+bool QMozWindowPrivate::startFrameCapture(const std::function<void(const QMozWindowFrame &)> &callback, int bufferCount)
+{
+    if (!callback) {
+        qCWarning(lcEmbedLiteExt) << "Frame capture requires a callback";
+        return false;
+    }
+
+    QMutexLocker lock(&mCaptureMutex);
+    freeCaptureRing();
+    mFrameCallback = callback;
+    mCaptureBufferCount = qBound(1, bufferCount, MOZWINDOW_CAPTURE_MAX_BUFFERS);
+    mDroppedFrames.store(0);
+    mCapturing.store(1);
+    return true;
+}
+
+void QMozWindowPrivate::stopFrameCapture()
+{
+    mCapturing.store(0);
+
+    QMutexLocker lock(&mCaptureMutex);
+    mFrameCallback = nullptr;
+    freeCaptureRing();
+}
+
+void QMozWindowPrivate::releaseFrame(const QMozWindowFrame &frame)
+{
+    if (frame.slot >= 0 && frame.slot < MOZWINDOW_CAPTURE_MAX_BUFFERS) {
+        mCaptureSlots[frame.slot].testAndSetRelease(frameTag(frame.sequence), 0);
+    }
+}
+
+// Called with mCaptureMutex held and no slots in use.
+bool QMozWindowPrivate::allocateCaptureRing(const QSize &size)
+{
+    freeCaptureRing();
+
+    const qint64 frameBytes = qint64(size.width()) * 4 * size.height();
+    const qint64 memorySize = frameBytes * mCaptureBufferCount;
+    if (memorySize <= 0) {
+        return false;
+    }
+
+    // Share the ring through a memfd so that an encoder in another process can map it.
+#ifdef SYS_memfd_create
+    int fd = syscall(SYS_memfd_create, "qtmozembed-frames", MFD_CLOEXEC);
+    if (fd >= 0 && ftruncate(fd, memorySize) == 0) {
+        void *memory = mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (memory != MAP_FAILED) {
+            mCaptureMemory = static_cast<uchar *>(memory);
+            mCaptureFd = fd;
+        }
+    }
+    if (!mCaptureMemory && fd >= 0) {
+        close(fd);
+    }
+#endif
+
+    if (!mCaptureMemory) {
+        void *memory = mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            qCWarning(lcEmbedLiteExt) << "Failed to allocate" << memorySize << "bytes for frame capture";
+            return false;
+        }
+        mCaptureMemory = static_cast<uchar *>(memory);
+    }
+
+    mCaptureMemorySize = memorySize;
+    mCaptureSize = size;
+    return true;
+}
+
+void QMozWindowPrivate::freeCaptureRing()
+{
+    if (mCaptureMemory) {
+        munmap(mCaptureMemory, mCaptureMemorySize);
+        mCaptureMemory = nullptr;
+    }
+    if (mCaptureFd >= 0) {
+        close(mCaptureFd);
+        mCaptureFd = -1;
+    }
+    mCaptureMemorySize = 0;
+    mCaptureSize = QSize();
+    for (QAtomicInt &slot : mCaptureSlots) {
+        slot.store(0);
     }
-    return false;
+}
+
+// Runs on the compositor thread with the window framebuffer bound.
+void QMozWindowPrivate::captureFrame()
+{
+    if (!mCapturing.load()) {
+        return;
+    }
+
+    const qint64 timestamp = monotonicMicroseconds();
+
+    QMutexLocker lock(&mCaptureMutex);
+    if (!mFrameCallback) {
+        return;
+    }
+
+    const QSize size = compositorState().size;
+    if (size != mCaptureSize) {
+        // Frames of the old size may still be read by the consumer.
+        for (int i = 0; i < mCaptureBufferCount; ++i) {
+            if (mCaptureSlots[i].load() != 0) {
+                mDroppedFrames.ref();
+                return;
+            }
+        }
+        if (!allocateCaptureRing(size)) {
+            mDroppedFrames.ref();
+            return;
+        }
+    }
+
+    const quint64 sequence = ++mCaptureSequence;
+    int slot = -1;
+    for (int i = 0; i < mCaptureBufferCount; ++i) {
+        if (mCaptureSlots[i].testAndSetAcquire(0, frameTag(sequence))) {
+            slot = i;
+            break;
+        }
+    }
+
+    if (slot < 0) {
+        // The consumer lags behind, drop rather than stall the compositor.
+        mDroppedFrames.ref();
+        return;
+    }
+
+    const int bytesPerLine = size.width() * 4;
+    const qint64 offset = qint64(slot) * bytesPerLine * size.height();
+    uchar *data = mCaptureMemory + offset;
+
+    while (glGetError());
+    glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, data);
+    if (glGetError() != GL_NO_ERROR) {
+        mCaptureSlots[slot].store(0);
+        mDroppedFrames.ref();
+        return;
+    }
+
+    QMozWindowFrame frame;
+    frame.data = data;
+    frame.size = size;
+    frame.bytesPerLine = bytesPerLine;
+    frame.fd = mCaptureFd;
+    frame.offset = offset;
+    frame.timestamp = timestamp;
+    frame.sequence = sequence;
+    frame.slot = slot;
+    mFrameCallback(frame);
 }
 
 void QMozWindowPrivate::WindowInitialized()
@@ -136,6 +577,7 @@ void QMozWindowPrivate::WindowDestroyed()
 
 void QMozWindowPrivate::DrawOverlay(const nsIntRect &aRect)
 {
+    mCompositeOverlay = monotonicMicroseconds();
     q.drawOverlay(QRect(aRect.x, aRect.y, aRect.width, aRect.height));
 }
 
@@ -147,12 +589,22 @@ void QMozWindowPrivate::CompositorCreated()
 
 void QMozWindowPrivate::CompositingFinished()
 {
-    q.drawOverlay(QRect(0, 0, mSize.width(), mSize.height()));
+    mCompositedOrientation.store(compositorState().orientation);
+    recordFrame(monotonicMicroseconds());
+    captureFrame();
+    const QSize size = compositorState().size;
+    q.drawOverlay(QRect(0, 0, size.width(), size.height()));
     q.compositingFinished();
 }
 
+bool QMozWindowPrivate::readyToPaint() const
+{
+    return compositorState().readyToPaint;
+}
+
 bool QMozWindowPrivate::PreRender()
 {
-    QMutexLocker lock(&mReadyToPaintMutex);
-    return mReadyToPaint;
+    const bool ready = readyToPaint();
+    mCompositeStart = ready ? monotonicMicroseconds() : 0;
+    return ready;
 }
@@ -7,12 +7,27 @@
 #define QMOZWINDOW_PRIVATE_H
 
 #include <QObject>
+#include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QMutex>
 #include <QSize>
+#include <QVector>
+
+#include <functional>
 
 #include "mozilla/embedlite/EmbedLiteWindow.h"
 
 class QMozWindow;
+struct QMozWindowFrame;
+
+// Number of composites kept in the frame timing history.
+#ifndef MOZWINDOW_FRAME_HISTORY
+#define MOZWINDOW_FRAME_HISTORY 240
+#endif
+
+#ifndef MOZWINDOW_CAPTURE_MAX_BUFFERS
+#define MOZWINDOW_CAPTURE_MAX_BUFFERS 8
+#endif
 
 class QMozWindowPrivate : public mozilla::embedlite::EmbedLiteWindowListener
 {
@@ -26,6 +41,37 @@ public:
 
     void timerEvent(QTimerEvent *event);
 
+    bool startFrameCapture(const std::function<void(const QMozWindowFrame &)> &callback, int bufferCount);
+    void stopFrameCapture();
+    void releaseFrame(const QMozWindowFrame &frame);
+
+    struct FrameTiming {
+        qint64 start = 0;
+        qint64 overlay = 0;
+        qint64 end = 0;
+    };
+
+    // Per frame parameters published by the UI thread for the compositor thread.
+    struct CompositorState {
+        QSize size;
+        Qt::ScreenOrientation orientation = Qt::PrimaryOrientation;
+        Qt::ScreenOrientation primaryOrientation = Qt::PrimaryOrientation;
+        bool readyToPaint = true;
+    };
+
+    CompositorState compositorState() const;
+
+    QVector<FrameTiming> frameHistory() const;
+    qreal fps() const;
+    qreal frameTimePercentile(qreal percentile) const;
+    qreal compositeTimePercentile(qreal percentile) const;
+    QByteArray frameTrace() const;
+    void resetFrameStats();
+    void notifyFrameStats();
+
+    // CLOCK_MONOTONIC time in microseconds, the clock of all frame timestamps.
+    static qint64 monotonicMicroseconds();
+
 protected:
     // EmbedLiteWindowListener:
     void WindowInitialized() override;
@@ -39,19 +85,63 @@ private:
     friend class QMozWindow;
     friend class QMozViewPrivate;
 
+    template <typename Update> void updateCompositorState(Update update);
     bool setReadyToPaint(bool ready);
+    bool readyToPaint() const;
+    void recordFrame(qint64 end);
+    bool allocateCaptureRing(const QSize &size);
+    void freeCaptureRing();
+    void captureFrame();
 
     QMozWindow &q;
     mozilla::embedlite::EmbedLiteWindow *mWindow;
     bool mCompositorCreated;
-    QMutex mReadyToPaintMutex;
-    bool mReadyToPaint;
+    // Seqlock around mCompositorState, the sequence is odd while it is
+    // written. Writers serialize on the mutex, readers never block.
+    QMutex mCompositorStateWriteMutex;
+    QAtomicInt mCompositorStateSequence;
+    CompositorState mCompositorState;
     QSize mSize;
     Qt::ScreenOrientation mOrientation;
     Qt::ScreenOrientation mPrimaryOrientation;
     Qt::ScreenOrientation mPendingOrientation;
     int mOrientationFilterTimer;
+    QElapsedTimer mOrientationChangeTime;
     bool mReserved;
+    // Content orientation in effect when the last frame was composited.
+    QAtomicInt mCompositedOrientation;
+
+    // Frame capture ring, written on the compositor thread.
+    QMutex mCaptureMutex;
+    std::function<void(const QMozWindowFrame &)> mFrameCallback;
+    uchar *mCaptureMemory;
+    qint64 mCaptureMemorySize;
+    int mCaptureFd;
+    QSize mCaptureSize;
+    int mCaptureBufferCount;
+    quint64 mCaptureSequence;
+    // Zero when free, otherwise the tag of the frame held by the consumer.
+    QAtomicInt mCaptureSlots[MOZWINDOW_CAPTURE_MAX_BUFFERS];
+    QAtomicInt mCapturing;
+    QAtomicInt mDroppedFrames;
+
+    // Frame timing history. Written only by the compositor thread, every slot
+    // is guarded by a sequence counter that is odd while the slot is written.
+    struct FrameTimingSlot {
+        QAtomicInt sequence;
+        FrameTiming timing;
+    };
+    FrameTimingSlot mFrameHistory[MOZWINDOW_FRAME_HISTORY];
+    QAtomicInt mFrameCount;
+    QAtomicInt mJankFrames;
+    QAtomicInt mMissedVsyncs;
+    QAtomicInt mFrameStatsPending;
+    qint64 mCompositeStart;
+    qint64 mCompositeOverlay;
+    qint64 mLastCompositeEnd;
+    qint64 mVsyncInterval;
+    int mFrameStatsTimer;
+    int mFrameStatsNotifiedCount;
 
     Q_DISABLE_COPY(QMozWindowPrivate)
 };
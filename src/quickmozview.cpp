@@ -30,10 +30,27 @@
 #include "qmozview_p.h"
 #include "qmozextmaterialnode.h"
 #include "qmozscrolldecorator.h"
+#include "qmozthumbnailcache_p.h"
 #include "qmozexttexture.h"
+#include "qmozgrabresult.h"
 #include "qmozwindow.h"
 #include "qmozwindow_p.h"
 
+// Upper bound of the last frame snapshot each view keeps to cover rendering gaps.
+#ifndef MOZVIEW_SNAPSHOT_MAX_BYTES
+#define MOZVIEW_SNAPSHOT_MAX_BYTES (4 * 1024 * 1024)
+#endif
+
+// Upper bound of the snapshots of all views together.
+#ifndef MOZVIEW_SNAPSHOT_TOTAL_BYTES
+#define MOZVIEW_SNAPSHOT_TOTAL_BYTES (16 * 1024 * 1024)
+#endif
+
+// Time a view with autoSuspend may stay out of sight before it is suspended.
+#ifndef MOZVIEW_SUSPEND_GRACE_PERIOD
+#define MOZVIEW_SUSPEND_GRACE_PERIOD 1000
+#endif
+
 using namespace mozilla;
 using namespace mozilla::embedlite;
 
@@ -73,12 +90,18 @@ QuickMozView::QuickMozView(QQuickItem *parent)
     : QQuickItem(parent)
     , d(new QMozViewPrivate(new IMozQView<QuickMozView>(*this), this))
     , mTexture(nullptr)
+    , mSnapshot(nullptr)
     , mOrientation(qApp->primaryScreen()->primaryOrientation())
+    , mSnapshotOrientation(Qt::PrimaryOrientation)
     , mExplicitViewportWidth(false)
     , mExplicitViewportHeight(false)
     , mExplicitOrientation(false)
     , mComposited(false)
     , mFollowItemGeometry(true)
+    , mShowingSnapshot(false)
+    , mAutoSuspend(false)
+    , mAutoSuspended(false)
+    , mEffectivelyVisible(false)
 {
     setFlag(ItemHasContents, true);
     setAcceptedMouseButtons(Qt::LeftButton | Qt::RightButton | Qt::MiddleButton);
@@ -94,7 +117,13 @@ QuickMozView::QuickMozView(QQuickItem *parent)
     connect(this, &QuickMozView::loadingChanged, d, &QMozViewPrivate::updateLoaded);
     connect(this, &QuickMozView::scrollableOffsetChanged, this, &QuickMozView::updateMargins);
     connect(this, &QuickMozView::firstPaint, this, &QQuickItem::update);
+    connect(d, &QMozViewPrivate::discardedChanged, this, &QuickMozView::discardedChanged);
     updateEnabled();
+    d->mDiscardable = true;
+
+    mSuspendTimer.setSingleShot(true);
+    mSuspendTimer.setInterval(MOZVIEW_SUSPEND_GRACE_PERIOD);
+    connect(&mSuspendTimer, &QTimer::timeout, this, &QuickMozView::autoSuspendTimeout);
 }
 
 QuickMozView::~QuickMozView()
@@ -102,10 +131,13 @@ QuickMozView::~QuickMozView()
     releaseResources();
 
     if (d->mView) {
+        QMozThumbnailCachePrivate::viewDestroyed(d->mView->GetUniqueID());
         d->mView->SetIsActive(false);
         d->mView->SetListener(nullptr);
         d->mContext->GetApp()->DestroyView(d->mView);
     }
+    QMutexLocker lock(&mGrabResultListLock);
+    mGrabResultList.clear();
     delete d;
     d = nullptr;
 }
@@ -114,6 +146,7 @@ void QuickMozView::SetIsActive(bool aIsActive)
 {
     if (QThread::currentThread() == thread() && d->mView) {
         d->mView->SetIsActive(aIsActive);
+        d->activeStateChanged();
     } else {
         Q_EMIT setIsActive(aIsActive);
     }
@@ -142,7 +175,17 @@ void QuickMozView::updateEnabled()
 void QuickMozView::itemChange(ItemChange change, const ItemChangeData &data)
 {
     if (change == ItemSceneChange) {
+        if (mVisibilityWindow) {
+            trackAncestorVisibility(false);
+            disconnect(mVisibilityWindow, &QWindow::visibilityChanged, this, &QuickMozView::updateEffectiveVisibility);
+        }
+        mVisibilityWindow = data.window;
         if (data.window) {
+            if (mAutoSuspend) {
+                trackAncestorVisibility(true);
+            }
+            connect(data.window, &QWindow::visibilityChanged, this, &QuickMozView::updateEffectiveVisibility);
+
             connect(data.window, &QQuickWindow::contentOrientationChanged, this, &QuickMozView::updateOrientation);
 
             // Update the orientation, but without emitting an orientationChanged signal
@@ -154,6 +197,17 @@ void QuickMozView::itemChange(ItemChange change, const ItemChangeData &data)
         }
     }
     QQuickItem::itemChange(change, data);
+
+    switch (change) {
+    case ItemSceneChange:
+    case ItemVisibleHasChanged:
+    case ItemOpacityHasChanged:
+    case ItemParentHasChanged:
+        updateEffectiveVisibility();
+        break;
+    default:
+        break;
+    }
 }
 
 void QuickMozView::geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry)
@@ -174,6 +228,10 @@ QSGNode * QuickMozView::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
         delete mTexture;
         mTexture = nullptr;
 
+        delete mSnapshot;
+        mSnapshot = nullptr;
+        mShowingSnapshot = false;
+
         return nullptr;
     }
 
@@ -184,6 +242,9 @@ QSGNode * QuickMozView::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
             || !d->mMozWindow;
 
     if (mTexture && invalidTexture) {
+        // Keep the last frame to cover the gap until the next composite.
+        updateSnapshot();
+
         delete oldNode;
         oldNode = nullptr;
 
@@ -193,31 +254,58 @@ QSGNode * QuickMozView::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
 
     QRectF boundingRect(d->renderingOffset(), d->mSize);
 
-    if (!mTexture && invalidTexture) {
-        QSGSimpleRectNode *node = static_cast<QSGSimpleRectNode *>(oldNode);
+#if defined(QT_OPENGL_ES_2)
+    if (!mTexture && !invalidTexture) {
+        QMozExtTexture * const texture = new QMozExtTexture;
+        connect(texture, &QMozExtTexture::getPlatformImage, d->mMozWindow, &QMozWindow::getPlatformImage, Qt::DirectConnection);
+
+        // Keep showing the snapshot until there is a new frame to replace it.
+        if (mSnapshot && !texture->updateTexture()) {
+            delete texture;
+        } else {
+            delete oldNode;
+            oldNode = nullptr;
+
+            delete mSnapshot;
+            mSnapshot = nullptr;
+            mShowingSnapshot = false;
+
+            mTexture = texture;
+        }
+    }
+#endif
+
+    if (!mTexture && mSnapshot) {
+        MozMaterialNode *node = mShowingSnapshot ? static_cast<MozMaterialNode *>(oldNode) : nullptr;
         if (!node) {
-            node = new QSGSimpleRectNode;
+            delete oldNode;
+            node = new MozRgbMaterialNode;
+            node->setTexture(mSnapshot);
+            mShowingSnapshot = true;
         }
-        node->setColor(d->mBackgroundColor);
         node->setRect(boundingRect);
+        node->setOrientation(mOrientation);
+        node->setFrameOrientation(mSnapshotOrientation);
+        node->setSurfaceOrientation(window() ? window()->contentOrientation() : Qt::PrimaryOrientation);
 
         return node;
     }
 
     if (!mTexture) {
-        delete oldNode;
-        oldNode = nullptr;
+        QSGSimpleRectNode *node = static_cast<QSGSimpleRectNode *>(oldNode);
+        if (!node) {
+            node = new QSGSimpleRectNode;
+        }
+        node->setColor(d->mBackgroundColor);
+        node->setRect(boundingRect);
+
+        return node;
     }
 
     MozMaterialNode *node = static_cast<MozMaterialNode *>(oldNode);
 
     if (!node) {
 #if defined(QT_OPENGL_ES_2)
-        QMozExtTexture * const texture = new QMozExtTexture;
-        mTexture = texture;
-
-        connect(texture, &QMozExtTexture::getPlatformImage, d->mMozWindow, &QMozWindow::getPlatformImage, Qt::DirectConnection);
-
         node = new MozExtMaterialNode;
 #else
 #warning "Implement me for non ES2 platform"
@@ -230,12 +318,60 @@ QSGNode * QuickMozView::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
 
     node->setRect(boundingRect);
     node->setOrientation(mOrientation);
+    node->setFrameOrientation(d->mMozWindow->compositedOrientation());
     node->setSurfaceOrientation(window() ? window()->contentOrientation() : Qt::PrimaryOrientation);
     node->markDirty(QSGNode::DirtyMaterial);
 
+    captureGrabResults();
+
     return node;
 }
 
+void QuickMozView::updateSnapshot()
+{
+#if defined(QT_OPENGL_ES_2)
+    if (QMozExtTexture * const texture = qobject_cast<QMozExtTexture *>(mTexture)) {
+        // The snapshot of this view is replaced, so its memory counts as available.
+        const QMozSnapshotTexture * const current = qobject_cast<QMozSnapshotTexture *>(mSnapshot);
+        const int available = MOZVIEW_SNAPSHOT_TOTAL_BYTES - QMozSnapshotTexture::totalByteCount()
+                + (current ? current->byteCount() : 0);
+        const int maxBytes = qMin(MOZVIEW_SNAPSHOT_MAX_BYTES, available);
+        if (QMozSnapshotTexture * const snapshot = texture->createSnapshot(maxBytes)) {
+            delete mSnapshot;
+            mSnapshot = snapshot;
+            mSnapshotOrientation = d->mMozWindow ? d->mMozWindow->compositedOrientation() : mOrientation;
+        }
+    }
+#endif
+}
+
+void QuickMozView::captureGrabResults()
+{
+#if defined(QT_OPENGL_ES_2)
+    QMutexLocker lock(&mGrabResultListLock);
+    QMozExtTexture * const texture = qobject_cast<QMozExtTexture *>(mTexture);
+    if (mGrabResultList.isEmpty() || !texture) {
+        return;
+    }
+
+    // Bind the latest frame now, the node preprocess finds the same image again.
+    texture->updateTexture();
+    if (texture->textureId() == 0) {
+        // Nothing composited yet, keep the grabs pending until the next frame.
+        return;
+    }
+
+    for (const QWeakPointer<QMozGrabResult> &weakResult : mGrabResultList) {
+        if (QSharedPointer<QMozGrabResult> result = weakResult.toStrongRef()) {
+            result->captureTexture(texture->textureId(), texture->textureSize());
+        } else {
+            qWarning() << "QMozGrabResult freed before being realized!";
+        }
+    }
+    mGrabResultList.clear();
+#endif
+}
+
 void QuickMozView::releaseResources()
 {
 #if defined(QT_OPENGL_ES_2)
@@ -248,6 +384,12 @@ void QuickMozView::releaseResources()
         window->scheduleRenderJob(new ObjectCleanup(mTexture), QQuickWindow::AfterSynchronizingStage);
         mTexture = nullptr;
     }
+
+    if (QQuickWindow * const window = mSnapshot ? QQuickItem::window() : nullptr) {
+        window->scheduleRenderJob(new ObjectCleanup(mSnapshot), QQuickWindow::AfterSynchronizingStage);
+        mSnapshot = nullptr;
+        mShowingSnapshot = false;
+    }
 }
 
 int QuickMozView::parentId() const
@@ -267,6 +409,14 @@ bool QuickMozView::active() const
 
 void QuickMozView::setActive(bool active)
 {
+    // An explicit change takes over from autoSuspend, which then leaves the
+    // view as it is. autoSuspendTimeout() marks its own suspend afterwards.
+    mAutoSuspended = false;
+
+    if (active && d->mDiscarded) {
+        restore();
+    }
+
     if (d->mViewInitialized) {
         if (d->mActive != active) {
             d->mActive = active;
@@ -320,9 +470,15 @@ void QuickMozView::updateContentSize(const QSizeF &size)
 
 void QuickMozView::compositingFinished()
 {
+    if (d->mView) {
+        QMozThumbnailCachePrivate::notifyPainted(d->mView->GetUniqueID());
+    }
     if (d->mActive) {
         mComposited = true;
-        update();
+        // Out of sight views with autoSuspend only repaint once visible again.
+        if (!mAutoSuspend || mEffectivelyVisible) {
+            update();
+        }
     }
 }
 
@@ -748,6 +904,30 @@ void QuickMozView::runJavaScript(const QString &script,
     d->runJavaScript(script, callback, errorCallback);
 }
 
+/*
+ * Runs \a script and passes its result or error to \a callback without
+ * going through a QML engine. Thread-safe, \a callback is called on the
+ * thread of the view.
+ */
+void QuickMozView::runJavaScript(const QString &script, const QMozJavaScriptCallback &callback)
+{
+    d->runJavaScript(script, callback);
+}
+
+/*
+ * Completes a sync message whose reply was deferred with
+ * QMozReturnValue::defer(). Thread-safe.
+ */
+void QuickMozView::replySyncMessage(uint token, const QVariant &message)
+{
+    d->replySyncMessage(token, message);
+}
+
+QMozViewDiagnostics *QuickMozView::diagnostics()
+{
+    return d->diagnostics();
+}
+
 // This should be a const method returning a pointer to a const object
 // but unfortunately this conflicts with it being exposed as a Q_PROPERTY
 QMozSecurity *QuickMozView::security()
@@ -861,17 +1041,187 @@ void QuickMozView::suspendView()
         return;
     }
     setActive(false);
-    d->mView->SuspendTimeouts();
+    d->setTimeoutsSuspended(true);
     d->mMozWindow->suspendRendering();
 }
 
 void QuickMozView::resumeView()
 {
-    if (!d->mViewInitialized) {
+    if (!d->mViewInitialized && !d->mDiscarded) {
         return;
     }
     setActive(true);
-    d->mView->ResumeTimeouts();
+    d->setTimeoutsSuspended(false);
+}
+
+/*!
+    \qmlproperty bool QmlMozView::autoSuspend
+
+    When true the view suspends itself once it has been out of sight for
+    suspendGracePeriod milliseconds, and resumes when it becomes visible again.
+    A view is out of sight when it or an ancestor is hidden or transparent, it
+    is clipped away or outside the window, or the window is not visible.
+    Changing active, suspendView() or resumeView() while the view is
+    suspended this way hands it back to the application and it is no longer
+    resumed automatically. Defaults to false.
+*/
+bool QuickMozView::autoSuspend() const
+{
+    return mAutoSuspend;
+}
+
+void QuickMozView::setAutoSuspend(bool autoSuspend)
+{
+    if (mAutoSuspend == autoSuspend) {
+        return;
+    }
+
+    mAutoSuspend = autoSuspend;
+    trackAncestorVisibility(mAutoSuspend);
+    if (!mAutoSuspend) {
+        mSuspendTimer.stop();
+        if (mAutoSuspended) {
+            mAutoSuspended = false;
+            resumeView();
+        }
+    } else if (!mEffectivelyVisible) {
+        mSuspendTimer.start();
+    }
+    Q_EMIT autoSuspendChanged();
+}
+
+int QuickMozView::suspendGracePeriod() const
+{
+    return mSuspendTimer.interval();
+}
+
+void QuickMozView::setSuspendGracePeriod(int gracePeriod)
+{
+    gracePeriod = qMax(0, gracePeriod);
+    if (mSuspendTimer.interval() != gracePeriod) {
+        mSuspendTimer.setInterval(gracePeriod);
+        Q_EMIT suspendGracePeriodChanged();
+    }
+}
+
+bool QuickMozView::effectivelyVisible() const
+{
+    return mEffectivelyVisible;
+}
+
+/*!
+    \qmlproperty bool QmlMozView::discarded
+
+    True while the view has been discarded to free memory. A discarded view
+    keeps its url, title and last frame but has no engine side view. It is
+    recreated when activated or when restore() is called, after which the
+    saved scroll position and form data are re-applied once loaded.
+*/
+bool QuickMozView::discarded() const
+{
+    return d->mDiscarded;
+}
+
+/*!
+    \qmlproperty var QmlMozView::discardedState
+
+    State saved when the view was discarded: url, title, scrollX, scrollY,
+    resolution and formData. Empty when the view has not been discarded.
+*/
+QVariantMap QuickMozView::discardedState() const
+{
+    return d->mDiscarded ? d->mDiscardedState : QVariantMap();
+}
+
+/*!
+    \qmlmethod bool QmlMozView::discard()
+
+    Discards an inactive view. Returns false if the view is active, not yet
+    initialized or already discarded. The view is destroyed asynchronously,
+    once form data has been collected from the page.
+*/
+bool QuickMozView::discard()
+{
+    return d->discard();
+}
+
+/*!
+    \qmlmethod void QmlMozView::restore()
+
+    Recreates a discarded view without activating it.
+*/
+void QuickMozView::restore()
+{
+    d->restore();
+}
+
+bool QuickMozView::computeEffectivelyVisible() const
+{
+    QQuickWindow * const window = QQuickItem::window();
+    if (!window || !window->isVisible() || window->visibility() == QWindow::Minimized
+            || !isVisible() || width() <= 0 || height() <= 0) {
+        return false;
+    }
+
+    QRectF visibleRect = mapRectToScene(boundingRect());
+    for (const QQuickItem *item = this; item; item = item->parentItem()) {
+        if (item->opacity() <= 0) {
+            return false;
+        }
+        if (item != this && item->clip()) {
+            visibleRect &= item->mapRectToScene(item->clipRect());
+        }
+    }
+    visibleRect &= QRectF(QPointF(0, 0), window->size());
+
+    return !visibleRect.isEmpty();
+}
+
+// Scrolling and ancestor opacity changes are not reported to the item, they
+// are re-checked once per animated frame while autoSuspend needs them.
+void QuickMozView::trackAncestorVisibility(bool track)
+{
+    if (!mVisibilityWindow) {
+        return;
+    }
+
+    if (track) {
+        connect(mVisibilityWindow.data(), &QQuickWindow::afterAnimating,
+                this, &QuickMozView::updateEffectiveVisibility, Qt::UniqueConnection);
+        updateEffectiveVisibility();
+    } else {
+        disconnect(mVisibilityWindow.data(), &QQuickWindow::afterAnimating,
+                   this, &QuickMozView::updateEffectiveVisibility);
+    }
+}
+
+void QuickMozView::updateEffectiveVisibility()
+{
+    const bool visible = computeEffectivelyVisible();
+    if (mEffectivelyVisible == visible) {
+        return;
+    }
+
+    mEffectivelyVisible = visible;
+    if (visible) {
+        mSuspendTimer.stop();
+        if (mAutoSuspended) {
+            mAutoSuspended = false;
+            resumeView();
+        }
+        update();
+    } else if (mAutoSuspend) {
+        mSuspendTimer.start();
+    }
+    Q_EMIT effectivelyVisibleChanged();
+}
+
+void QuickMozView::autoSuspendTimeout()
+{
+    if (mAutoSuspend && !mEffectivelyVisible && d->mViewInitialized && d->mActive) {
+        suspendView();
+        mAutoSuspended = true;
+    }
 }
 
 void QuickMozView::touchEvent(QTouchEvent *event)
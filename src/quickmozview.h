@@ -12,17 +12,24 @@
 
 #include <QMatrix>
 #include <QMutex>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QVariantMap>
 #include <QtQuick/QQuickItem>
 #include <QtGui/QOpenGLShaderProgram>
 #include "qmozview_defined_wrapper.h"
 
 QT_BEGIN_NAMESPACE
 class QSGTexture;
+class QQuickWindow;
 QT_END_NAMESPACE
 
 class QMozViewPrivate;
 class QMozWindow;
 class QMozSecurity;
+class QMozViewDiagnostics;
+class QMozGrabResult;
 
 class QuickMozView : public QQuickItem
 {
@@ -34,6 +41,11 @@ class QuickMozView : public QQuickItem
     Q_PROPERTY(Qt::ScreenOrientation orientation READ orientation WRITE setOrientation NOTIFY orientationChanged RESET resetOrientation FINAL)
     Q_PROPERTY(qreal viewportWidth READ viewportWidth WRITE setViewportWidth NOTIFY viewportWidthChanged RESET resetViewportWidth)
     Q_PROPERTY(qreal viewportHeight READ viewportHeight WRITE setViewportHeight NOTIFY viewportHeightChanged RESET resetViewportHeight)
+    Q_PROPERTY(bool autoSuspend READ autoSuspend WRITE setAutoSuspend NOTIFY autoSuspendChanged FINAL)
+    Q_PROPERTY(int suspendGracePeriod READ suspendGracePeriod WRITE setSuspendGracePeriod NOTIFY suspendGracePeriodChanged FINAL)
+    Q_PROPERTY(bool effectivelyVisible READ effectivelyVisible NOTIFY effectivelyVisibleChanged FINAL)
+    Q_PROPERTY(bool discarded READ discarded NOTIFY discardedChanged FINAL)
+    Q_PROPERTY(QVariantMap discardedState READ discardedState NOTIFY discardedChanged FINAL)
 
     Q_MOZ_VIEW_PROPERTIES
 
@@ -66,6 +78,23 @@ public:
     void setViewportHeight(qreal height);
     void resetViewportHeight();
 
+    bool autoSuspend() const;
+    void setAutoSuspend(bool autoSuspend);
+
+    int suspendGracePeriod() const;
+    void setSuspendGracePeriod(int gracePeriod);
+
+    bool effectivelyVisible() const;
+
+    bool discarded() const;
+    QVariantMap discardedState() const;
+    Q_INVOKABLE bool discard();
+    Q_INVOKABLE void restore();
+
+    QSharedPointer<QMozGrabResult> grabContentToImage(const QSize &targetSize = QSize(),
+                                                      const QSize &sourceSize = QSize(),
+                                                      int filterPasses = -1);
+
 private:
     void updateGLContextInfo();
 
@@ -82,6 +111,10 @@ Q_SIGNALS:
     void orientationChanged();
     void viewportWidthChanged();
     void viewportHeightChanged();
+    void autoSuspendChanged();
+    void suspendGracePeriodChanged();
+    void effectivelyVisibleChanged();
+    void discardedChanged();
 
     Q_MOZ_VIEW_SIGNALS
 
@@ -119,20 +152,36 @@ public Q_SLOTS:
 private Q_SLOTS:
     void updateEnabled();
     void updateOrientation(Qt::ScreenOrientation orientation);
+    void updateEffectiveVisibility();
+    void autoSuspendTimeout();
 
 private:
     void updateContentSize(const QSizeF &size);
     void prepareMozWindow();
+    void captureGrabResults();
+    void updateSnapshot();
+    bool computeEffectivelyVisible() const;
+    void trackAncestorVisibility(bool track);
 
     QMozViewPrivate *d;
     QSGTexture *mTexture;
+    QSGTexture *mSnapshot;
     friend class QMozViewPrivate;
     Qt::ScreenOrientation mOrientation;
+    Qt::ScreenOrientation mSnapshotOrientation;
     bool mExplicitViewportWidth;
     bool mExplicitViewportHeight;
     bool mExplicitOrientation;
     bool mComposited;
     bool mFollowItemGeometry;
+    bool mShowingSnapshot;
+    bool mAutoSuspend;
+    bool mAutoSuspended;
+    bool mEffectivelyVisible;
+    QTimer mSuspendTimer;
+    QPointer<QQuickWindow> mVisibilityWindow;
+    QMutex mGrabResultListLock;
+    QList<QWeakPointer<QMozGrabResult> > mGrabResultList;
 };
 
 #endif // QuickMozView_H
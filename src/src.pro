@@ -30,7 +30,10 @@ SOURCES += qmozcontext.cpp \
            geckoworker.cpp \
            qmozopenglwebpage.cpp \
            qmozwindow.cpp \
-           qmozwindow_p.cpp
+           qmozwindow_p.cpp \
+           qmozthumbnailcache.cpp \
+           qmozviewpool.cpp \
+           qmozviewdiagnostics.cpp
 
 HEADERS += qmozcontext.h \
            qmozcontext_p.h \
@@ -48,7 +51,11 @@ HEADERS += qmozcontext.h \
            qmozview_templated_wrapper.h \
            qmozopenglwebpage.h \
            qmozwindow.h \
-           qmozwindow_p.h
+           qmozwindow_p.h \
+           qmozthumbnailcache.h \
+           qmozthumbnailcache_p.h \
+           qmozviewpool_p.h \
+           qmozviewdiagnostics.h
 
 SOURCES += quickmozview.cpp qmozexttexture.cpp qmozextmaterialnode.cpp
 HEADERS += quickmozview.h qmozexttexture.h qmozextmaterialnode.h
@@ -61,7 +68,7 @@ include($$RELATIVE_PATH/relative-objdir.pri)
 
 PREFIX = /usr
 
-QT += quick qml
+QT += quick qml concurrent
 
 #DEFINES += Q_DEBUG_LOG
 
@@ -9,6 +9,12 @@ TestWindow {
     id: appWindow
 
     property var lastObserveMessage
+    property var lastSubscribedMessage
+    property int subscribedMessageCount
+    property var threadSubscribedMessage
+    property var syncMessageToken
+    property var syncMessageReturned
+    property var syncMessageReply
 
     name: testcaseid.name
 
@@ -19,6 +25,33 @@ TestWindow {
         }
     }
 
+    Connections {
+        target: TestHelper
+        onObserved: {
+            lastSubscribedMessage = { msg: topic, data: data }
+            ++subscribedMessageCount
+        }
+        onObservedOnThread: {
+            threadSubscribedMessage = { msg: topic, inReceiverThread: inReceiverThread }
+        }
+    }
+
+    Connections {
+        target: appWindow.mozView
+        onRecvSyncMessage: {
+            if (message === "testembed:syncmessage") {
+                syncMessageToken = response.defer()
+            }
+        }
+        onRecvAsyncMessage: {
+            if (message === "testembed:syncmessagereturned") {
+                syncMessageReturned = data.value
+            } else if (message === "testembed:syncmessagereply") {
+                syncMessageReply = data
+            }
+        }
+    }
+
     TestCase {
         id: testcaseid
 
@@ -37,12 +70,78 @@ TestWindow {
             MyScript.dumpTs("test_context1Init end")
         }
 
+        function test_context2EnginePreload() {
+            MyScript.dumpTs("test_context2EnginePreload start")
+            verify(TestHelper.enginePreloaded())
+            verify(TestHelper.engineLoaded())
+
+            var tasksRun = 0
+            var countTask = function() { ++tasksRun }
+            TestHelper.uiTaskRun.connect(countTask)
+            verify(TestHelper.postUITask())
+            verify(MyScript.wrtWait(function() { return tasksRun === 0 }, 10, 500))
+            TestHelper.uiTaskRun.disconnect(countTask)
+            MyScript.dumpTs("test_context2EnginePreload end")
+        }
+
         function test_context3PrefAPI() {
             MyScript.dumpTs("test_context3PrefAPI start")
             QMozEngineSettings.setPreference("test.embedlite.pref", "result");
             MyScript.dumpTs("test_context3PrefAPI end")
         }
 
+        function test_context3PrefBindings() {
+            MyScript.dumpTs("test_context3PrefBindings start")
+            QMozEngineSettings.bindPreference("test.embedlite.bound.", QMozEngineSettings.IntPref)
+            QMozEngineSettings.setPreference("test.embedlite.bound.value", 42)
+            verify(MyScript.wrtWait(function() {
+                return QMozEngineSettings.preference("test.embedlite.bound.value") !== 42 }, 10, 500))
+            MyScript.dumpTs("test_context3PrefBindings end")
+        }
+
+        function test_context3PrefBatch() {
+            MyScript.dumpTs("test_context3PrefBatch start")
+            var changes = []
+            var recordChange = function(name, value) {
+                if (name.indexOf("test.embedlite.batch.") === 0) {
+                    changes.push(name + "=" + value)
+                }
+            }
+            QMozEngineSettings.preferenceChanged.connect(recordChange)
+            QMozEngineSettings.bindPreference("test.embedlite.batch.", QMozEngineSettings.IntPref)
+
+            // Nothing is sent before the outermost commit, a key set twice is sent once.
+            QMozEngineSettings.beginBatch()
+            QMozEngineSettings.setPreference("test.embedlite.batch.a", 1)
+            QMozEngineSettings.beginBatch()
+            QMozEngineSettings.setPreference("test.embedlite.batch.b", 2)
+            QMozEngineSettings.setPreference("test.embedlite.batch.a", 3)
+            QMozEngineSettings.commit()
+            wait(500)
+            compare(QMozEngineSettings.preference("test.embedlite.batch.a"), undefined)
+            compare(QMozEngineSettings.preference("test.embedlite.batch.b"), undefined)
+            QMozEngineSettings.commit()
+            verify(MyScript.wrtWait(function() {
+                return QMozEngineSettings.preference("test.embedlite.batch.a") !== 3
+                        || QMozEngineSettings.preference("test.embedlite.batch.b") !== 2 }, 10, 500))
+            compare(changes, ["test.embedlite.batch.a=3", "test.embedlite.batch.b=2"])
+
+            QMozEngineSettings.setPreferences({"test.embedlite.batch.c": 4, "test.embedlite.batch.d": 5})
+            verify(MyScript.wrtWait(function() {
+                return QMozEngineSettings.preference("test.embedlite.batch.c") !== 4
+                        || QMozEngineSettings.preference("test.embedlite.batch.d") !== 5 }, 10, 500))
+
+            // An unmatched commit is ignored and leaves later changes unbatched.
+            QMozEngineSettings.commit()
+            QMozEngineSettings.setPreference("test.embedlite.batch.a", 6)
+            verify(MyScript.wrtWait(function() {
+                return QMozEngineSettings.preference("test.embedlite.batch.a") !== 6 }, 10, 500))
+
+            QMozEngineSettings.unbindPreference("test.embedlite.batch.")
+            QMozEngineSettings.preferenceChanged.disconnect(recordChange)
+            MyScript.dumpTs("test_context3PrefBatch end")
+        }
+
         function test_context4ObserveAPI() {
             MyScript.dumpTs("test_context4ObserveAPI start")
             QmlMozContext.notifyObservers("memory-pressure", null)
@@ -55,5 +154,111 @@ TestWindow {
             compare(lastObserveMessage.data.msg, "testMessage")
             MyScript.dumpTs("test_context4ObserveAPI end")
         }
+
+        function test_context4SubscribeAPI() {
+            MyScript.dumpTs("test_context4SubscribeAPI start")
+            lastSubscribedMessage = undefined
+            subscribedMessageCount = 0
+            TestHelper.subscribe("test-subscribe-message")
+            QmlMozContext.notifyObservers("test-subscribe-message", {msg: "testMessage", val: 1})
+            verify(MyScript.wrtWait(function() { return lastSubscribedMessage === undefined }, 10, 500))
+            compare(lastSubscribedMessage.msg, "test-subscribe-message")
+            compare(lastSubscribedMessage.data.val, 1)
+            compare(lastSubscribedMessage.data.msg, "testMessage")
+            compare(subscribedMessageCount, 1)
+
+            TestHelper.unsubscribe("test-subscribe-message")
+            QmlMozContext.notifyObservers("test-subscribe-message", {msg: "testMessage", val: 2})
+            wait(500)
+            compare(subscribedMessageCount, 1)
+            MyScript.dumpTs("test_context4SubscribeAPI end")
+        }
+
+        function test_context4SubscribeOnThread() {
+            MyScript.dumpTs("test_context4SubscribeOnThread start")
+            threadSubscribedMessage = undefined
+            TestHelper.subscribeOnThread("test-subscribe-thread-message")
+            QmlMozContext.notifyObservers("test-subscribe-thread-message", {msg: "testMessage"})
+            verify(MyScript.wrtWait(function() { return threadSubscribedMessage === undefined }, 10, 500))
+            compare(threadSubscribedMessage.msg, "test-subscribe-thread-message")
+            verify(threadSubscribedMessage.inReceiverThread)
+            MyScript.dumpTs("test_context4SubscribeOnThread end")
+        }
+
+        function test_context5StartupTimeline() {
+            MyScript.dumpTs("test_context5StartupTimeline start")
+            QmlMozContext.addStartupMark("TestMark")
+            var marks = QmlMozContext.startupTimeline()
+            var names = marks.map(function(mark) { return mark.name })
+            verify(names.indexOf("Initialized") >= 0)
+            compare(names[names.length - 1], "TestMark")
+            for (var i = 1; i < marks.length; ++i) {
+                verify(marks[i].time >= marks[i - 1].time)
+            }
+            MyScript.dumpTs("test_context5StartupTimeline end")
+        }
+
+        // Round trips a deferred sync message through the test frame script.
+        function sendDeferredSyncMessage(view, reply) {
+            syncMessageToken = undefined
+            syncMessageReturned = undefined
+            syncMessageReply = undefined
+
+            view.sendAsyncMessage("embedtest:syncmessage", {val: 1})
+            verify(MyScript.wrtWait(function() { return syncMessageReturned === undefined }, 10, 500))
+            verify(syncMessageToken > 0)
+            compare(syncMessageReply, undefined)
+
+            view.replySyncMessage(syncMessageToken, reply)
+            verify(MyScript.wrtWait(function() { return syncMessageReply === undefined }, 10, 500))
+        }
+
+        function test_context6DeferredSyncReply() {
+            MyScript.dumpTs("test_context6DeferredSyncReply start")
+            verify(MyScript.waitMozView())
+            var view = appWindow.mozView
+            view.loadFrameScript("chrome://tests/content/testHelper.js")
+            view.addMessageListener("testembed:syncmessage")
+            view.addMessageListener("testembed:syncmessagereturned")
+            view.addMessageListener("testembed:syncmessagereply")
+
+            sendDeferredSyncMessage(view, {answer: 42})
+            compare(syncMessageReturned.deferred, syncMessageToken)
+            compare(syncMessageReply.token, syncMessageToken)
+            compare(syncMessageReply.message.answer, 42)
+            MyScript.dumpTs("test_context6DeferredSyncReply end")
+        }
+
+        function test_context7MessageLatencies() {
+            MyScript.dumpTs("test_context7MessageLatencies start")
+            verify(MyScript.waitMozView())
+            var view = appWindow.mozView
+            var diagnostics = view.diagnostics
+            verify(diagnostics.latencyThreshold > 0)
+
+            diagnostics.reset()
+            compare(Object.keys(diagnostics.messageLatencies()).length, 0)
+
+            // The frame script and listeners were set up by test_context6DeferredSyncReply.
+            sendDeferredSyncMessage(view, {answer: 7})
+
+            var latencies = diagnostics.messageLatencies()
+            var sync = latencies["testembed:syncmessage"]
+            verify(sync !== undefined)
+            compare(sync.blocking, true)
+            compare(sync.count, 1)
+            verify(sync.max >= sync.mean)
+            compare(sync.histogram.length, 12)
+            compare(sync.histogram.reduce(function(sum, count) { return sum + count }, 0), 1)
+
+            var reply = latencies["testembed:syncmessagereply"]
+            verify(reply !== undefined)
+            compare(reply.blocking, false)
+            compare(reply.count, 1)
+
+            diagnostics.reset()
+            compare(Object.keys(diagnostics.messageLatencies()).length, 0)
+            MyScript.dumpTs("test_context7MessageLatencies end")
+        }
     }
 }
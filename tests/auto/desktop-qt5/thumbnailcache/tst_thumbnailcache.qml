@@ -0,0 +1,121 @@
+import QtTest 1.0
+import QtQuick 2.0
+import Qt5Mozilla 1.0
+import QtMozEmbed.Tests 1.0
+import "../../shared/componentCreation.js" as MyScript
+import "../../shared"
+
+TestWindow {
+    id: appWindow
+
+    // 100x100 RGB32 thumbnails.
+    readonly property int thumbnailCost: 100 * 100 * 4
+    property int defaultBudget
+
+    name: testcaseid.name
+
+    Image {
+        id: fullImage
+        cache: false
+    }
+
+    Image {
+        id: scaledImage
+        cache: false
+        sourceSize: Qt.size(50, 50)
+    }
+
+    TestCase {
+        id: testcaseid
+
+        name: "tst_thumbnailcache"
+        when: windowShown
+
+        function initTestCase() {
+            defaultBudget = QMozThumbnailCache.budget
+        }
+
+        function cleanupTestCase() {
+            MyScript.dumpTs("tst_thumbnailcache cleanupTestCase")
+            fullImage.source = ""
+            scaledImage.source = ""
+            QMozThumbnailCache.clear()
+            QMozThumbnailCache.budget = defaultBudget
+        }
+
+        function test_thumbnail1LruBudget() {
+            MyScript.dumpTs("test_thumbnail1LruBudget start")
+            QMozThumbnailCache.clear()
+            compare(QMozThumbnailCache.cost, 0)
+            QMozThumbnailCache.budget = 3 * thumbnailCost
+
+            TestHelper.insertThumbnail(1001, 100, 100, "#ff0000")
+            TestHelper.insertThumbnail(1002, 100, 100, "#00ff00")
+            TestHelper.insertThumbnail(1003, 100, 100, "#0000ff")
+            compare(QMozThumbnailCache.cost, 3 * thumbnailCost)
+            verify(QMozThumbnailCache.contains(1001))
+
+            // Reading 1001 through the image provider makes 1002 the least recently used.
+            fullImage.source = QMozThumbnailCache.url(1001)
+            tryCompare(fullImage, "status", Image.Ready)
+
+            TestHelper.insertThumbnail(1004, 100, 100, "#ffffff")
+            compare(QMozThumbnailCache.cost, 3 * thumbnailCost)
+            verify(QMozThumbnailCache.contains(1001))
+            verify(!QMozThumbnailCache.contains(1002))
+            verify(QMozThumbnailCache.contains(1003))
+            verify(QMozThumbnailCache.contains(1004))
+            compare(String(QMozThumbnailCache.url(1002)), "")
+
+            QMozThumbnailCache.budget = thumbnailCost
+            compare(QMozThumbnailCache.cost, thumbnailCost)
+            verify(QMozThumbnailCache.contains(1004))
+            verify(!QMozThumbnailCache.contains(1001))
+
+            // The most recent thumbnail is kept even if it alone exceeds the budget.
+            QMozThumbnailCache.budget = 1
+            verify(QMozThumbnailCache.contains(1004))
+
+            QMozThumbnailCache.remove(1004)
+            verify(!QMozThumbnailCache.contains(1004))
+            compare(QMozThumbnailCache.cost, 0)
+            MyScript.dumpTs("test_thumbnail1LruBudget end")
+        }
+
+        function test_thumbnail2ImageProvider() {
+            MyScript.dumpTs("test_thumbnail2ImageProvider start")
+            QMozThumbnailCache.clear()
+            QMozThumbnailCache.budget = defaultBudget
+
+            TestHelper.insertThumbnail(1101, 100, 50, "#ff0000")
+            var url = String(QMozThumbnailCache.url(1101))
+            verify(url.indexOf("image://mozthumbnail/1101/") === 0)
+
+            fullImage.source = url
+            tryCompare(fullImage, "status", Image.Ready)
+            compare(fullImage.implicitWidth, 100)
+            compare(fullImage.implicitHeight, 50)
+            var pixel = grabImage(fullImage).pixel(50, 25)
+            verify(pixel.r > 0.9)
+            verify(pixel.g < 0.1)
+            verify(pixel.b < 0.1)
+
+            // Requested sizes scale down keeping the aspect ratio.
+            scaledImage.source = url
+            tryCompare(scaledImage, "status", Image.Ready)
+            compare(scaledImage.implicitWidth, 50)
+            compare(scaledImage.implicitHeight, 25)
+
+            // Replacing a thumbnail changes its url.
+            TestHelper.insertThumbnail(1101, 100, 50, "#00ff00")
+            verify(String(QMozThumbnailCache.url(1101)) !== url)
+
+            // Unknown thumbnails fail to load.
+            QMozThumbnailCache.remove(1101)
+            fullImage.source = ""
+            fullImage.source = url
+            tryCompare(fullImage, "status", Image.Error)
+            MyScript.dumpTs("test_thumbnail2ImageProvider end")
+        }
+    }
+}
@@ -50,5 +50,123 @@ TestWindow {
             verify(MyScript.wrtWait(function() { return !webViewport.painted }))
             MyScript.dumpTs("test_Test2LoadAboutMozillaCheckTitle end")
         }
+
+        function test_Test3SnapshotWhileInactive() {
+            MyScript.dumpTs("test_Test3SnapshotWhileInactive start")
+            webViewport.url = "data:text/html,<body style='background-color: #ff0000'></body>"
+            verify(MyScript.waitLoadFinished(webViewport))
+            verify(MyScript.wrtWait(function() { return !webViewport.painted }))
+            wait(500)
+
+            // The last frame stays up instead of the background color.
+            webViewport.active = false
+            wait(500)
+            var pixel = grabImage(webViewport).pixel(webViewport.width / 2, webViewport.height / 2)
+            verify(pixel.r > 0.9)
+            verify(pixel.g < 0.1)
+            verify(pixel.b < 0.1)
+
+            webViewport.active = true
+            verify(MyScript.wrtWait(function() { return !webViewport.painted }))
+            MyScript.dumpTs("test_Test3SnapshotWhileInactive end")
+        }
+
+        function test_Test4AutoSuspend() {
+            MyScript.dumpTs("test_Test4AutoSuspend start")
+            verify(webViewport.active)
+            webViewport.suspendGracePeriod = 100
+            webViewport.autoSuspend = true
+
+            webViewport.visible = false
+            tryCompare(webViewport, "effectivelyVisible", false)
+            tryCompare(webViewport, "active", false)
+            webViewport.visible = true
+            tryCompare(webViewport, "effectivelyVisible", true)
+            tryCompare(webViewport, "active", true)
+
+            // Once the application suspends the view itself it stays suspended.
+            webViewport.visible = false
+            tryCompare(webViewport, "active", false)
+            webViewport.suspendView()
+            webViewport.visible = true
+            tryCompare(webViewport, "effectivelyVisible", true)
+            wait(500)
+            verify(!webViewport.active)
+
+            // Turning autoSuspend off resumes only views it suspended.
+            webViewport.resumeView()
+            verify(webViewport.active)
+            webViewport.visible = false
+            tryCompare(webViewport, "active", false)
+            webViewport.autoSuspend = false
+            verify(webViewport.active)
+
+            webViewport.visible = true
+            webViewport.suspendGracePeriod = 1000
+            MyScript.dumpTs("test_Test4AutoSuspend end")
+        }
+
+        function test_Test5DiscardRestore() {
+            MyScript.dumpTs("test_Test5DiscardRestore start")
+            var url = "data:text/html,<input id='field'>"
+            webViewport.url = url
+            verify(MyScript.waitLoadFinished(webViewport))
+            webViewport.runJavaScript("document.getElementById('field').value = 'typed'")
+            verify(!webViewport.discard())
+
+            webViewport.active = false
+            verify(webViewport.discard())
+            tryCompare(webViewport, "discarded", true)
+            compare(webViewport.discardedState.url, url)
+            compare(webViewport.discardedState.formData.length, 1)
+            compare(webViewport.discardedState.formData[0].value, "typed")
+
+            // Activating recreates the view and refills the form.
+            webViewport.active = true
+            tryCompare(webViewport, "discarded", false)
+            verify(MyScript.waitLoadFinished(webViewport))
+            var value = ""
+            verify(MyScript.wrtWait(function() {
+                webViewport.runJavaScript("return document.getElementById('field').value", function(result) {
+                    value = result
+                })
+                return value !== "typed"
+            }, 50, 100))
+            compare(value, "typed")
+            MyScript.dumpTs("test_Test5DiscardRestore end")
+        }
+
+        function test_Test6ViewTiers() {
+            MyScript.dumpTs("test_Test6ViewTiers start")
+            var uniqueId = webViewport.uniqueId
+            var tierChanges = []
+            var recordTier = function(id, tier) {
+                if (id === uniqueId) {
+                    tierChanges.push(tier)
+                }
+            }
+            QmlMozContext.viewTierChanged.connect(recordTier)
+            compare(QmlMozContext.viewTier(0), -1)
+            verify(MyScript.wrtWait(function() {
+                return QmlMozContext.viewTier(uniqueId) !== QmlMozContext.ForegroundTier }, 10, 500))
+
+            // Tiers are tracked even without throttling.
+            var throttling = QmlMozContext.viewThrottling
+            QmlMozContext.viewThrottling = false
+            webViewport.active = false
+            verify(MyScript.wrtWait(function() {
+                return QmlMozContext.viewTier(uniqueId) !== QmlMozContext.BackgroundRecentTier }, 10, 500))
+            compare(tierChanges, [QmlMozContext.BackgroundRecentTier])
+
+            QmlMozContext.viewThrottling = true
+            webViewport.active = true
+            verify(MyScript.wrtWait(function() {
+                return QmlMozContext.viewTier(uniqueId) !== QmlMozContext.ForegroundTier }, 10, 500))
+            compare(tierChanges, [QmlMozContext.BackgroundRecentTier, QmlMozContext.ForegroundTier])
+
+            QmlMozContext.viewThrottling = throttling
+            QmlMozContext.viewTierChanged.disconnect(recordTier)
+            MyScript.dumpTs("test_Test6ViewTiers end")
+        }
     }
 }
@@ -0,0 +1,119 @@
+import QtTest 1.0
+import QtQuick 2.0
+import Qt5Mozilla 1.0
+import QtMozEmbed.Tests 1.0
+import "../../shared/componentCreation.js" as MyScript
+import "../../shared"
+
+TestWindow {
+    id: appWindow
+
+    property var viewComponent
+    property var views: []
+    property int initializedViews
+    property int defaultPoolSize
+
+    name: testcaseid.name
+
+    TestCase {
+        id: testcaseid
+
+        name: "tst_viewpool"
+        when: windowShown
+
+        function startView(properties) {
+            var view = viewComponent.createObject(appWindow, properties)
+            view.viewInitialized.connect(function() { ++initializedViews })
+            views.push(view)
+            return view
+        }
+
+        function waitViews() {
+            return MyScript.wrtWait(function() { return initializedViews < views.length }, 100, 100)
+        }
+
+        function createView(properties) {
+            var view = startView(properties)
+            verify(waitViews())
+            return view
+        }
+
+        function waitAvailable(count) {
+            return MyScript.wrtWait(function() {
+                return QmlMozContext.viewPoolStats().available !== count }, 100, 100)
+        }
+
+        function initTestCase() {
+            verify(MyScript.waitMozContext())
+            defaultPoolSize = QmlMozContext.viewPoolSize
+            viewComponent = Qt.createComponent(TestHelper.getenv("QTTESTSROOT") + "/auto/shared/ViewComponent.qml")
+            compare(viewComponent.status, Component.Ready)
+        }
+
+        function cleanupTestCase() {
+            MyScript.dumpTs("tst_viewpool cleanupTestCase")
+            for (var i = 0; i < views.length; ++i) {
+                views[i].destroy()
+            }
+            QmlMozContext.viewPoolSize = defaultPoolSize
+            wait(1000)
+        }
+
+        function test_viewPool1Refill() {
+            MyScript.dumpTs("test_viewPool1Refill start")
+            // The first view registers the window the pool binds its views to.
+            createView({"active": true})
+            QmlMozContext.viewPoolSize = 1
+            compare(QmlMozContext.viewPoolSize, 1)
+            verify(waitAvailable(1))
+            compare(QmlMozContext.viewPoolStats().availablePrivate, 0)
+            MyScript.dumpTs("test_viewPool1Refill end")
+        }
+
+        function test_viewPool2Hit() {
+            MyScript.dumpTs("test_viewPool2Hit start")
+            var stats = QmlMozContext.viewPoolStats()
+            createView({"active": true})
+            compare(QmlMozContext.viewPoolStats().hits, stats.hits + 1)
+            compare(QmlMozContext.viewPoolStats().misses, stats.misses)
+            verify(QmlMozContext.viewPoolStats().lastCreationTime >= 0)
+            verify(waitAvailable(1))
+            MyScript.dumpTs("test_viewPool2Hit end")
+        }
+
+        function test_viewPool3Miss() {
+            MyScript.dumpTs("test_viewPool3Miss start")
+            var stats = QmlMozContext.viewPoolStats()
+            // The second view comes before the pool refills.
+            startView({"active": true})
+            startView({"active": true})
+            verify(waitViews())
+            compare(QmlMozContext.viewPoolStats().hits, stats.hits + 1)
+            compare(QmlMozContext.viewPoolStats().misses, stats.misses + 1)
+            verify(waitAvailable(1))
+            MyScript.dumpTs("test_viewPool3Miss end")
+        }
+
+        function test_viewPool4DesktopMode() {
+            MyScript.dumpTs("test_viewPool4DesktopMode start")
+            var stats = QmlMozContext.viewPoolStats()
+            var view = createView({"active": true, "desktopMode": true})
+            verify(view.desktopMode)
+            compare(QmlMozContext.viewPoolStats().hits, stats.hits)
+            compare(QmlMozContext.viewPoolStats().misses, stats.misses)
+            compare(QmlMozContext.viewPoolStats().available, 1)
+            MyScript.dumpTs("test_viewPool4DesktopMode end")
+        }
+
+        function test_viewPool5Shrink() {
+            MyScript.dumpTs("test_viewPool5Shrink start")
+            QmlMozContext.viewPoolSize = 0
+            compare(QmlMozContext.viewPoolStats().available, 0)
+            var stats = QmlMozContext.viewPoolStats()
+            // An empty pool is not a miss.
+            createView({"active": true})
+            compare(QmlMozContext.viewPoolStats().misses, stats.misses)
+            MyScript.dumpTs("test_viewPool5Shrink end")
+        }
+    }
+}
@@ -33,6 +33,8 @@ TestHelper.prototype = {
     addMessageListener("embedtest:focustoelement", this);
     addMessageListener("embedtest:clickelement", this);
     addMessageListener("embedtest:useragent", this);
+    addMessageListener("embedtest:syncmessage", this);
+    addMessageListener("embedui:syncMessageReply", this);
   },
 
   observe: function(aSubject, aTopic, data) {
@@ -66,6 +68,15 @@ TestHelper.prototype = {
         sendAsyncMessage("testembed:useragent", {value: content.navigator.userAgent});
         break;
       }
+      case "embedtest:syncmessage": {
+        let reply = sendSyncMessage("testembed:syncmessage", aMessage.json)[0];
+        sendAsyncMessage("testembed:syncmessagereturned", {value: reply});
+        break;
+      }
+      case "embedui:syncMessageReply": {
+        sendAsyncMessage("testembed:syncmessagereply", aMessage.json);
+        break;
+      }
       default: {
         break;
       }
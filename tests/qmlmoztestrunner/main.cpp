@@ -56,6 +56,10 @@ int main(int argc, char **argv)
 {
     QGuiApplication app(argc, argv);
 
+    // Load the engine while the test components are set up, the context
+    // created below waits for it.
+    QMozContext::preloadEngine();
+
     qmlRegisterType<TestViewCreator>("QtMozEmbed.Tests", 1, 0, "WebViewCreator");
     qmlRegisterSingletonType<TestHelper>("QtMozEmbed.Tests", 1, 0, "TestHelper",
                                                     testHelperFactory);
@@ -7,14 +7,80 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "testhelper.h"
+#include "qmozcontext.h"
+#include "qmozthumbnailcache.h"
+#include <QFuture>
+#include <QImage>
 #include <QString>
 
 TestHelper::TestHelper(QObject *parent)
     : QObject(parent)
+    , mThreadReceiver(nullptr)
 {
 }
 
+TestHelper::~TestHelper()
+{
+    mSubscriberThread.quit();
+    mSubscriberThread.wait();
+    delete mThreadReceiver;
+}
+
 QString TestHelper::getenv(const QString &envVarName) const
 {
     return QString(::getenv(envVarName.toUtf8().constData()));
 }
+
+void TestHelper::subscribe(const QString &topic)
+{
+    QMozContext::instance()->subscribe(topic, this, [this](const QString &topic, const QVariant &data) {
+        Q_EMIT observed(topic, data);
+    });
+}
+
+void TestHelper::unsubscribe(const QString &topic)
+{
+    QMozContext::instance()->unsubscribe(topic, this);
+}
+
+void TestHelper::subscribeOnThread(const QString &topic)
+{
+    if (!mThreadReceiver) {
+        mThreadReceiver = new QObject;
+        mThreadReceiver->moveToThread(&mSubscriberThread);
+        mSubscriberThread.start();
+    }
+
+    QObject *receiver = mThreadReceiver;
+    QMozContext::instance()->subscribe(topic, receiver, [this, receiver](const QString &topic, const QVariant &) {
+        const bool inReceiverThread = QThread::currentThread() == receiver->thread();
+        QMetaObject::invokeMethod(this, "observedOnThread", Qt::QueuedConnection,
+                                  Q_ARG(QString, topic), Q_ARG(bool, inReceiverThread));
+    });
+}
+
+bool TestHelper::enginePreloaded() const
+{
+    // Returns the load started by main() rather than starting a new one.
+    const QFuture<bool> bootstrap = QMozContext::preloadEngine();
+    return bootstrap.isStarted() && bootstrap.isFinished() && bootstrap.result();
+}
+
+bool TestHelper::engineLoaded() const
+{
+    return QMozContext::instance()->isEngineLoaded();
+}
+
+bool TestHelper::postUITask()
+{
+    return QMozContext::instance()->PostUITask([](void *data) {
+        QMetaObject::invokeMethod(static_cast<TestHelper *>(data), "uiTaskRun", Qt::QueuedConnection);
+    }, this) != nullptr;
+}
+
+void TestHelper::insertThumbnail(uint uniqueId, int width, int height, const QColor &color)
+{
+    QImage image(width, height, QImage::Format_RGB32);
+    image.fill(color);
+    QMozThumbnailCache::instance()->insert(uniqueId, image);
+}
@@ -9,7 +9,10 @@
 #ifndef TEST_HELPER_H
 #define TEST_HELPER_H
 
+#include <QColor>
 #include <QObject>
+#include <QThread>
+#include <QVariant>
 
 class TestHelper : public QObject
 {
@@ -17,8 +20,34 @@ class TestHelper : public QObject
 
 public:
     explicit TestHelper(QObject *parent = nullptr);
+    ~TestHelper();
 
     Q_INVOKABLE QString getenv(const QString &envVarName) const;
+
+    // QMozContext::subscribe() is C++ only, these forward it to observed().
+    Q_INVOKABLE void subscribe(const QString &topic);
+    Q_INVOKABLE void unsubscribe(const QString &topic);
+    // Subscribes a receiver living in a worker thread, see observedOnThread().
+    Q_INVOKABLE void subscribeOnThread(const QString &topic);
+
+    // Engine preloading and task posting are C++ only.
+    Q_INVOKABLE bool enginePreloaded() const;
+    Q_INVOKABLE bool engineLoaded() const;
+    // Posts a task to the engine UI thread, uiTaskRun() is emitted once it has run.
+    Q_INVOKABLE bool postUITask();
+
+    // QMozThumbnailCache::insert() is C++ only, inserts a filled image.
+    Q_INVOKABLE void insertThumbnail(uint uniqueId, int width, int height, const QColor &color);
+
+Q_SIGNALS:
+    void observed(const QString &topic, const QVariant &data);
+    void uiTaskRun();
+    // inReceiverThread tells whether the callback ran in the receiver's thread.
+    void observedOnThread(const QString &topic, bool inReceiverThread);
+
+private:
+    QThread mSubscriberThread;
+    QObject *mThreadReceiver;
 };
 
 #endif